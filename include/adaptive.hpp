@@ -0,0 +1,388 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// adaptive : combinator boundaries that decide for themselves, at
+//            run time, whether to run fused on the consumer's thread
+//            or split onto a thread and queue of their own (a stage).
+//
+//      auto budget = std::make_shared<gcomb::thread_budget> (8);
+//
+//      gcomb::adaptive_options opt;
+//      opt.budget = budget;
+//
+//      auto a = gcomb::adaptive (gcomb::bind (parse, lines), opt);
+//      auto b = gcomb::adaptive (gcomb::bind (enrich, a), opt);
+//      auto c = gcomb::bind (score, b);
+//
+// note:
+//      Each boundary samples the cost of producing a value upstream (p)
+//      and the time the consumer spends between pulls (c). Running the
+//      two sides on separate threads can at best hide the cheaper of
+//      them, min (p, c), and costs a queue hand-off per value; so every
+//      `period` values the boundary splits when min (p, c) exceeds the
+//      hand-off cost, and fuses again once it drops below half of it.
+//
+//      Decisions are local, so they compose: a boundary whose upstream
+//      is already split sees only the cost of a queue pop and stays
+//      fused, while the expensive stages of a long pipeline end up on
+//      threads of their own. A shared thread_budget caps how many
+//      boundaries may be split at once across any number of pipelines.
+//
+//      Switching is order preserving: to fuse, the boundary stops its
+//      thread and keeps whatever was queued, serving it before pulling
+//      upstream directly again.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_ADAPTIVE_HPP
+#define GCOMB_ADAPTIVE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "algebraic_generator.hpp"
+#include "channel.hpp"
+#include "generator.hpp"
+#include "sync.hpp"
+
+namespace gcomb
+{
+    // the number of threads adaptive boundaries may occupy
+    //
+    class thread_budget
+    {
+    public:
+        explicit thread_budget (unsigned n = std::thread::hardware_concurrency ())
+            : available (static_cast<int> (n ? n : 1))
+        {}
+
+        bool try_acquire (void) noexcept
+        {
+            auto n = available.load (std::memory_order_relaxed);
+            while (n > 0)
+                if (available.compare_exchange_weak (n, n - 1))
+                    return true;
+            return false;
+        }
+
+        void release (void) noexcept
+        {
+            available.fetch_add (1);
+        }
+
+    private:
+        std::atomic<int> available;
+    };
+
+
+    struct adaptive_options
+    {
+        // queue capacity while split
+        std::size_t capacity = 1024;
+
+        // estimated cost of handing one value across a queue
+        std::chrono::nanoseconds handoff {200};
+
+        // values between rebalancing decisions
+        std::size_t period = 1 << 14;
+
+        // time one in every 2^sample_shift values
+        unsigned sample_shift = 4;
+
+        wait_policy policy = wait_policy::hybrid;
+
+        // shared cap on split boundaries (unlimited when null)
+        std::shared_ptr<thread_budget> budget;
+    };
+
+namespace detail
+{
+    template <typename T>
+    class adaptive_state
+    {
+        using clock = std::chrono::steady_clock;
+
+    public:
+        adaptive_state (std::function<bool (T &)> pull,
+                        adaptive_options const& opt)
+            : pull (std::move (pull)), opt (opt), split (false), ended (false),
+              calls (0), timing_gap (false), cons_ns (0), cons_n (0),
+              prod_ns (0), prod_n (0), stop (false), exited (false),
+              upstream_ended (false)
+        {
+            sample_mask = (std::uint64_t (1) << opt.sample_shift) - 1;
+            if (this->opt.period == 0)
+                this->opt.period = 1;
+        }
+
+        adaptive_state (adaptive_state const&) = delete;
+        adaptive_state & operator= (adaptive_state const&) = delete;
+
+        ~adaptive_state (void) noexcept
+        {
+            if (split) {
+                stop.store (true);
+                queue->close ();
+                worker.join ();
+                if (opt.budget)
+                    opt.budget->release ();
+            }
+        }
+
+        bool next (T & out)
+        {
+            if (timing_gap) {
+                cons_ns += elapsed (gap_start);
+                ++cons_n;
+                timing_gap = false;
+            }
+
+            bool const sample = (++calls & sample_mask) == 0;
+            bool const ok = fetch (out, sample);
+
+            if (calls % opt.period == 0)
+                rebalance ();
+
+            if (sample) {
+                gap_start  = clock::now ();
+                timing_gap = true;
+            }
+
+            return ok;
+        }
+
+        bool is_split (void) const noexcept { return split; }
+
+    private:
+        static std::uint64_t elapsed (clock::time_point since) noexcept
+        {
+            return static_cast<std::uint64_t>
+                (std::chrono::duration_cast<std::chrono::nanoseconds>
+                    (clock::now () - since).count ());
+        }
+
+        bool fetch (T & out, bool sample)
+        {
+            if (not pending.empty ()) {
+                out = std::move (pending.front ());
+                pending.pop_front ();
+                return true;
+            }
+
+            if (deferred)
+                std::rethrow_exception (std::exchange (deferred, nullptr));
+
+            if (ended)
+                return false;
+
+            if (split) {
+                if (queue->pop (out))
+                    return true;
+
+                // the producer finished (or failed); it has exited
+                worker.join ();
+                split = false;
+                ended = true;
+                if (opt.budget)
+                    opt.budget->release ();
+                if (error)
+                    std::rethrow_exception (std::exchange (error, nullptr));
+                return false;
+            }
+
+            bool ok;
+            if (sample) {
+                auto const t0 = clock::now ();
+                ok = pull (out);
+                prod_ns.fetch_add (elapsed (t0), std::memory_order_relaxed);
+                prod_n.fetch_add (1, std::memory_order_relaxed);
+            } else {
+                ok = pull (out);
+            }
+
+            if (not ok)
+                ended = true;
+            return ok;
+        }
+
+        void rebalance (void)
+        {
+            auto const pn = prod_n.exchange (0, std::memory_order_relaxed);
+            auto const pt = prod_ns.exchange (0, std::memory_order_relaxed);
+
+            if (pn == 0 || cons_n == 0 || ended)
+                return;
+
+            auto const p = pt / pn;
+            auto const c = cons_ns / cons_n;
+            cons_ns = cons_n = 0;
+
+            auto const gain = p < c ? p : c;
+            auto const h = static_cast<std::uint64_t> (opt.handoff.count ());
+
+            if (not split && gain > h) {
+                if (not opt.budget || opt.budget->try_acquire ())
+                    start ();
+            } else if (split && gain < h / 2) {
+                halt ();
+                if (opt.budget)
+                    opt.budget->release ();
+            }
+        }
+
+        void start (void)
+        {
+            queue = std::unique_ptr<channel<T>>
+                (new channel<T> (opt.capacity, opt.policy));
+            stop.store (false);
+            exited.store (false);
+            split = true;
+
+            worker = std::thread ([this] (void)
+            {
+                std::uint64_t n = 0;
+                try {
+                    while (not stop.load (std::memory_order_relaxed)) {
+                        T value;
+                        bool ok;
+
+                        if ((++n & sample_mask) == 0) {
+                            auto const t0 = clock::now ();
+                            ok = pull (value);
+                            prod_ns.fetch_add (elapsed (t0), std::memory_order_relaxed);
+                            prod_n.fetch_add (1, std::memory_order_relaxed);
+                        } else {
+                            ok = pull (value);
+                        }
+
+                        if (not ok) {
+                            upstream_ended.store (true, std::memory_order_relaxed);
+                            break;
+                        }
+
+                        if (not queue->push (std::move (value)))
+                            break;
+                    }
+                } catch (...) {
+                    error = std::current_exception ();
+                }
+
+                exited.store (true, std::memory_order_release);
+                queue->close ();
+            });
+        }
+
+        // stop the producer, keeping everything it already queued
+        //
+        void halt (void)
+        {
+            stop.store (true);
+
+            T value;
+            while (not exited.load (std::memory_order_acquire)) {
+                if (queue->try_pop (value))
+                    pending.push_back (std::move (value));
+                else
+                    std::this_thread::yield ();
+            }
+
+            worker.join ();
+            while (queue->try_pop (value))
+                pending.push_back (std::move (value));
+
+            split = false;
+            if (upstream_ended.load (std::memory_order_relaxed))
+                ended = true;
+            if (error) {
+                deferred = std::exchange (error, nullptr);
+                ended = true;
+            }
+        }
+
+        std::function<bool (T &)> pull;
+        adaptive_options opt;
+        std::uint64_t sample_mask;
+
+        bool split;
+        bool ended;
+        std::deque<T> pending;
+        std::exception_ptr deferred;
+
+        // consumer side measurements
+        std::uint64_t calls;
+        bool timing_gap;
+        clock::time_point gap_start;
+        std::uint64_t cons_ns;
+        std::uint64_t cons_n;
+
+        // producer side measurements, written by whichever thread pulls
+        std::atomic<std::uint64_t> prod_ns;
+        std::atomic<std::uint64_t> prod_n;
+
+        // the split mode machinery
+        std::unique_ptr<channel<T>> queue;
+        std::thread worker;
+        std::atomic<bool> stop;
+        std::atomic<bool> exited;
+        std::atomic<bool> upstream_ended;
+        std::exception_ptr error;
+    };
+} // namespace detail
+
+    template <typename T>
+    generator<T> adaptive (generator<T> const& g,
+                           adaptive_options const& opt = adaptive_options ())
+    {
+        auto const st = std::make_shared<detail::adaptive_state<T>>
+            ([g] (T & out) { out = g (); return true; }, opt);
+
+        return generator<T>
+            ([st] (void) -> T
+            {
+                T value;
+                if (not st->next (value))
+                    throw std::logic_error ("gcomb: infinite stage ran dry");
+                return value;
+            });
+    }
+
+
+    template <typename T>
+    algebraic_generator<T, bot_t> adaptive (algebraic_generator<T, bot_t> const& g,
+                                            adaptive_options const& opt = adaptive_options ())
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        auto const st = std::make_shared<detail::adaptive_state<T>>
+            ([g] (T & out)
+            {
+                auto const v = g ();
+                if (is_bot (v))
+                    return false;
+                out = v.template value<T> ();
+                return true;
+            }, opt);
+
+        return algebraic_generator<T, bot_t>
+            ([st] (void) -> A
+            {
+                T value;
+                if (not st->next (value))
+                    return A (bot_t{});
+                return A (std::move (value));
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_ADAPTIVE_HPP
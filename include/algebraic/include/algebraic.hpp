@@ -22,7 +22,9 @@
 //
 
 #include <algorithm>
+#include <cassert>
 #include <memory>
+#include <tuple>
 #include <type_traits>
 
 namespace algebraic
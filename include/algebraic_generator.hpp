@@ -29,6 +29,17 @@ namespace gcomb
 {
     template <typename T, typename ... Ts>
     using algebraic_generator = generator<algebraic::algebraic<T, Ts...>>;
+
+
+    // bounded generators are written as algebraic_generator<T, bot_t>;
+    // this tests whether a value drawn from one marks the end of the
+    // stream.
+    //
+    template <typename T>
+    bool is_bot (algebraic::algebraic<T, bot_t> const& a) noexcept
+    {
+        return a.type_index () == 1;
+    }
 } // namespace gcomb
 
 #endif // ifndef GCOMB_ALGEBRAIC_GENERATOR_HPP
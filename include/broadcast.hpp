@@ -0,0 +1,238 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// broadcast : feeding every value of one stream to several consumers
+//             in a single pass.
+//
+//      auto r = gcomb::broadcast (values,
+//                                 sum_sink {},
+//                                 histogram_sink {},
+//                                 gcomb::socket_writer<double> (fd));
+//
+//      std::get<0> (r).total ...
+//      std::get<2> (r).close ();
+//
+// note:
+//      Each sink is any callable accepting a T const&. The upstream is
+//      pulled exactly once per value, which is then handed to every sink
+//      in argument order; the sinks are returned (in a tuple) once the
+//      generator reverts to bot. For an infinite generator, broadcast
+//      bound (g, n).
+//
+//      Sinks are moved in; pass std::ref (sink) to keep one in place
+//      instead. Writers (socket_writer, shm_writer, columnar_writer)
+//      still need their close () once the broadcast returns.
+//
+//      broadcast_threaded runs each sink on a thread of its own. Values
+//      are gathered into batches of `batch` values; every batch is
+//      allocated once and shared read-only by all sinks through their
+//      own channel (see channel.hpp) of at most `depth` batches, so the
+//      slowest sink sets the pace and memory stays bounded. An exception
+//      from the upstream or any sink stops the broadcast and is rethrown
+//      once every thread has been joined.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_BROADCAST_HPP
+#define GCOMB_BROADCAST_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "algebraic_generator.hpp"
+#include "channel.hpp"
+#include "generator.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    template <typename Tup, typename T, std::size_t ... I>
+    void broadcast_one (Tup & sinks, T const& value, std::index_sequence<I...>)
+    {
+        int const expand[] = {0, (std::get<I> (sinks) (value), 0)...};
+        (void) expand;
+    }
+
+
+    template <typename T>
+    using broadcast_batch = std::shared_ptr<std::vector<T> const>;
+
+
+    // one consumer thread per sink, each draining a channel of batches
+    //
+    template <typename T>
+    class broadcast_group
+    {
+    public:
+        broadcast_group (std::size_t sinks, std::size_t depth)
+            : stopped (false)
+        {
+            queues.reserve (sinks);
+            for (std::size_t i = 0; i < sinks; ++i)
+                queues.emplace_back (depth);
+        }
+
+        broadcast_group (broadcast_group const&) = delete;
+        broadcast_group & operator= (broadcast_group const&) = delete;
+
+        ~broadcast_group (void) noexcept
+        {
+            finish ();
+        }
+
+        template <typename Sink>
+        void start (std::size_t i, Sink & sink)
+        {
+            auto q = queues[i];
+            threads.emplace_back ([this,q,&sink] (void) mutable
+            {
+                try {
+                    broadcast_batch<T> b;
+                    while (q.pop (b))
+                        for (auto const& v : *b)
+                            sink (v);
+                } catch (...) {
+                    fail (std::current_exception ());
+                }
+            });
+        }
+
+        // hand a batch to every sink; false once the broadcast has failed
+        //
+        bool publish (broadcast_batch<T> const& b)
+        {
+            for (auto & q : queues)
+                q.push (b);
+            return not stopped.load (std::memory_order_acquire);
+        }
+
+        void fail (std::exception_ptr e) noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock (m);
+                if (not error)
+                    error = e;
+            }
+            stopped.store (true, std::memory_order_release);
+            for (auto & q : queues)
+                q.close ();
+        }
+
+        // close every queue, join every thread and rethrow the first error
+        //
+        void join (void)
+        {
+            finish ();
+            if (error)
+                std::rethrow_exception (error);
+        }
+
+    private:
+        void finish (void) noexcept
+        {
+            for (auto & q : queues)
+                q.close ();
+            for (auto & t : threads)
+                if (t.joinable ())
+                    t.join ();
+        }
+
+        std::vector<channel<broadcast_batch<T>>> queues;
+        std::vector<std::thread> threads;
+        std::atomic<bool> stopped;
+        std::mutex m;
+        std::exception_ptr error;
+    };
+
+
+    template <typename T, typename Tup, std::size_t ... I>
+    void broadcast_threaded_impl (algebraic_generator<T, bot_t> const& g,
+                                  Tup & sinks,
+                                  std::size_t batch,
+                                  std::size_t depth,
+                                  std::index_sequence<I...>)
+    {
+        broadcast_group<T> group (sizeof...(I), depth);
+
+        int const expand[] = {0, (group.start (I, std::get<I> (sinks)), 0)...};
+        (void) expand;
+
+        try {
+            auto buf = std::make_shared<std::vector<T>> ();
+            buf->reserve (batch);
+
+            for (;;) {
+                auto const v = g ();
+                bool const end = is_bot (v);
+
+                if (not end)
+                    buf->push_back (v.template value<T> ());
+
+                if (buf->size () == batch || (end && not buf->empty ())) {
+                    if (not group.publish (buf))
+                        break;
+                    buf = std::make_shared<std::vector<T>> ();
+                    buf->reserve (batch);
+                }
+
+                if (end)
+                    break;
+            }
+        } catch (...) {
+            group.fail (std::current_exception ());
+        }
+
+        group.join ();
+    }
+} // namespace detail
+
+    // pull every value of g once and give it to each sink in turn;
+    // returns the sinks.
+    //
+    template <typename T, typename ... Sinks>
+    std::tuple<Sinks...> broadcast (algebraic_generator<T, bot_t> const& g,
+                                    Sinks ... sinks)
+    {
+        std::tuple<Sinks...> out (std::move (sinks)...);
+
+        for (;;) {
+            auto const v = g ();
+            if (is_bot (v))
+                break;
+            detail::broadcast_one (out, v.template value<T> (),
+                                   std::index_sequence_for<Sinks...> {});
+        }
+
+        return out;
+    }
+
+
+    // as broadcast, with each sink running on its own thread behind a
+    // queue of at most depth batches of batch values.
+    //
+    template <typename T, typename ... Sinks>
+    std::tuple<Sinks...> broadcast_threaded (algebraic_generator<T, bot_t> const& g,
+                                             std::size_t batch,
+                                             std::size_t depth,
+                                             Sinks ... sinks)
+    {
+        std::tuple<Sinks...> out (std::move (sinks)...);
+
+        detail::broadcast_threaded_impl (g, out, batch ? batch : 1, depth ? depth : 1,
+                                         std::index_sequence_for<Sinks...> {});
+        return out;
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_BROADCAST_HPP
@@ -0,0 +1,343 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// channel : a bounded, lock-free, multi-producer/multi-consumer
+//           queue whose consuming end is a generator.
+//
+//      gcomb::channel<event> ch (1 << 16);
+//
+//      // any number of threads:
+//      ch.push (e);
+//
+//      // the pipeline:
+//      auto events = ch.as_generator ();  // reverts to bot after close ()
+//
+// note:
+//      The queue is D. Vyukov's bounded MPMC design: each slot carries
+//      a sequence number telling producers and consumers whether it is
+//      free or full for the current lap, so both ends claim slots with
+//      a single compare-and-swap and never take a lock.
+//
+//      A producer finding the channel full (or a consumer finding it
+//      empty) waits according to the channel's wait_policy; sleeping
+//      waiters are parked on futex event counts that the other side
+//      only signals when somebody is actually asleep.
+//
+//      A channel is a handle: copies refer to the same queue, which
+//      lives as long as any copy (or generator made from one) does.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_CHANNEL_HPP
+#define GCOMB_CHANNEL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "sync.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    constexpr std::size_t cache_line = 64;
+
+    template <typename T>
+    class mpmc_queue
+    {
+    public:
+        explicit mpmc_queue (std::size_t capacity)
+        {
+            std::size_t cap = 2;
+            while (cap < capacity)
+                cap <<= 1;
+
+            mask  = cap - 1;
+            cells = std::unique_ptr<cell[]> (new cell[cap]);
+
+            for (std::size_t i = 0; i < cap; ++i)
+                cells[i].seq.store (i, std::memory_order_relaxed);
+
+            enqueue_pos.store (0, std::memory_order_relaxed);
+            dequeue_pos.store (0, std::memory_order_relaxed);
+        }
+
+        mpmc_queue (mpmc_queue const&) = delete;
+        mpmc_queue & operator= (mpmc_queue const&) = delete;
+
+        ~mpmc_queue (void) noexcept
+        {
+            auto pos = dequeue_pos.load (std::memory_order_acquire);
+            auto const end = enqueue_pos.load (std::memory_order_acquire);
+
+            for (; pos != end; ++pos) {
+                auto & c = cells[pos & mask];
+                if (c.seq.load (std::memory_order_acquire) == pos + 1)
+                    reinterpret_cast<T *> (&c.storage)->~T ();
+            }
+        }
+
+        template <typename U>
+        bool try_push (U && value)
+        {
+            cell * c;
+            auto pos = enqueue_pos.load (std::memory_order_relaxed);
+
+            for (;;) {
+                c = &cells[pos & mask];
+                auto const seq = c->seq.load (std::memory_order_acquire);
+                auto const dif = static_cast<std::intptr_t> (seq) -
+                                 static_cast<std::intptr_t> (pos);
+
+                if (dif == 0) {
+                    if (enqueue_pos.compare_exchange_weak
+                            (pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (dif < 0) {
+                    return false; // full
+                } else {
+                    pos = enqueue_pos.load (std::memory_order_relaxed);
+                }
+            }
+
+            new (&c->storage) T (std::forward<U> (value));
+            c->seq.store (pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop (T & out)
+        {
+            cell * c;
+            auto pos = dequeue_pos.load (std::memory_order_relaxed);
+
+            for (;;) {
+                c = &cells[pos & mask];
+                auto const seq = c->seq.load (std::memory_order_acquire);
+                auto const dif = static_cast<std::intptr_t> (seq) -
+                                 static_cast<std::intptr_t> (pos + 1);
+
+                if (dif == 0) {
+                    if (dequeue_pos.compare_exchange_weak
+                            (pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (dif < 0) {
+                    return false; // empty
+                } else {
+                    pos = dequeue_pos.load (std::memory_order_relaxed);
+                }
+            }
+
+            auto const p = reinterpret_cast<T *> (&c->storage);
+            out = std::move (*p);
+            p->~T ();
+
+            c->seq.store (pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // a slot is free for producers when its sequence number equals
+        // their position, and full for consumers one lap later
+        //
+        bool has_room (void) const noexcept
+        {
+            auto const pos = enqueue_pos.load (std::memory_order_acquire);
+            auto const seq = cells[pos & mask].seq.load (std::memory_order_acquire);
+            return seq == pos;
+        }
+
+        bool empty (void) const noexcept
+        {
+            auto const pos = dequeue_pos.load (std::memory_order_acquire);
+            auto const seq = cells[pos & mask].seq.load (std::memory_order_acquire);
+            return seq != pos + 1;
+        }
+
+        std::size_t capacity (void) const noexcept { return mask + 1; }
+
+        std::size_t size_approx (void) const noexcept
+        {
+            auto const tail = enqueue_pos.load (std::memory_order_relaxed);
+            auto const head = dequeue_pos.load (std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+    private:
+        struct cell
+        {
+            std::atomic<std::size_t> seq;
+            typename std::aligned_storage<sizeof (T), alignof (T)>::type storage;
+        };
+
+        std::unique_ptr<cell[]> cells;
+        std::size_t mask;
+
+        alignas (cache_line) std::atomic<std::size_t> enqueue_pos;
+        alignas (cache_line) std::atomic<std::size_t> dequeue_pos;
+    };
+
+
+    template <typename T>
+    struct channel_state
+    {
+        channel_state (std::size_t capacity, wait_policy p)
+            : queue (capacity), policy (p), closed (false)
+        {}
+
+        mpmc_queue<T> queue;
+        wait_policy policy;
+        std::atomic<bool> closed;
+
+        event_count not_empty;
+        event_count not_full;
+    };
+} // namespace detail
+
+    template <typename T>
+    class channel
+    {
+    public:
+        using value_type = T;
+
+        explicit channel (std::size_t capacity,
+                          wait_policy policy = wait_policy::hybrid)
+            : st (std::make_shared<detail::channel_state<T>> (capacity, policy))
+        {}
+
+        // enqueue a value, waiting while the channel is full; returns
+        // false (dropping the value) if the channel has been closed.
+        //
+        template <typename U>
+        bool push (U && value)
+        {
+            for (;;) {
+                if (st->closed.load (std::memory_order_acquire))
+                    return false;
+
+                if (st->queue.try_push (std::forward<U> (value))) {
+                    st->not_empty.notify ();
+                    return true;
+                }
+
+                auto const s = st.get ();
+                detail::wait_until ([s] (void)
+                    {
+                        return s->closed.load (std::memory_order_acquire) ||
+                            s->queue.has_room ();
+                    },
+                    st->not_full, st->policy);
+            }
+        }
+
+        template <typename U>
+        bool try_push (U && value)
+        {
+            if (st->closed.load (std::memory_order_acquire) ||
+                not st->queue.try_push (std::forward<U> (value)))
+                return false;
+
+            st->not_empty.notify ();
+            return true;
+        }
+
+        // dequeue a value, waiting while the channel is empty; returns
+        // false once the channel is closed and drained.
+        //
+        bool pop (T & out)
+        {
+            for (;;) {
+                if (st->queue.try_pop (out)) {
+                    space_freed ();
+                    return true;
+                }
+
+                if (st->closed.load (std::memory_order_acquire)) {
+                    // values pushed before close are still delivered
+                    if (st->queue.try_pop (out)) {
+                        space_freed ();
+                        return true;
+                    }
+                    return false;
+                }
+
+                auto const s = st.get ();
+                detail::wait_until ([s] (void)
+                    {
+                        return s->closed.load (std::memory_order_acquire) ||
+                            not s->queue.empty ();
+                    },
+                    st->not_empty, st->policy);
+            }
+        }
+
+        bool try_pop (T & out)
+        {
+            if (not st->queue.try_pop (out))
+                return false;
+
+            space_freed ();
+            return true;
+        }
+
+        // refuse further pushes and wake every waiter; consumers still
+        // receive whatever was queued.
+        //
+        void close (void) noexcept
+        {
+            st->closed.store (true, std::memory_order_release);
+            st->not_empty.notify (true);
+            st->not_full.notify (true);
+        }
+
+        bool is_closed (void) const noexcept
+        {
+            return st->closed.load (std::memory_order_acquire);
+        }
+
+        std::size_t capacity (void) const noexcept
+        {
+            return st->queue.capacity ();
+        }
+
+        // the consuming end as a bounded generator: values in arrival
+        // order, then bot once the channel is closed and drained.
+        //
+        algebraic_generator<T, bot_t> as_generator (void) const
+        {
+            using A = algebraic::algebraic<T, bot_t>;
+
+            auto ch = *this;
+            return algebraic_generator<T, bot_t>
+                ([ch] (void) mutable -> A
+                {
+                    T value;
+                    if (not ch.pop (value))
+                        return A (bot_t{});
+                    return A (std::move (value));
+                });
+        }
+
+    private:
+        // producers blocked on a full channel are only woken once it has
+        // half drained, rather than being bounced awake for every slot
+        //
+        void space_freed (void) noexcept
+        {
+            if (st->queue.size_approx () <= st->queue.capacity () / 2)
+                st->not_full.notify (true);
+        }
+
+        std::shared_ptr<detail::channel_state<T>> st;
+    };
+} // namespace gcomb
+
+#endif // ifndef GCOMB_CHANNEL_HPP
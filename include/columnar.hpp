@@ -0,0 +1,661 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// columnar : a minimal columnar file format for persisting
+//            streams of tuples and re-reading subsets of their
+//            columns.
+//
+//      columnar_writer<Ts...> : sink accepting std::tuple<Ts...> rows
+//      write_columnar         : drain a generator of tuples into a file
+//      columnar_reader        : projecting reader over such a file
+//
+// Layout (all integers native endian):
+//
+//      [header, one page]
+//      [block 0: column 0 chunk][column 1 chunk]...[column n-1 chunk]
+//      [block 1: ...]
+//      ...
+//      [index: column descriptors, then per block its row count and,
+//              per column, the chunk offset and min/max statistics]
+//
+//      Every chunk begins on a page boundary and holds the block's
+//      values of one column as a plain array, so chunks can be used
+//      in place from a read-only mapping.
+//
+// note:
+//      Columns must be trivially copyable. Min/max statistics are kept
+//      for arithmetic columns and used by columnar_reader::where to skip
+//      whole blocks.
+//
+//      Only close () completes a file; one whose writer is destroyed
+//      without it is left unreadable, like an aborted shm or socket
+//      stream.
+//
+//      The reader maps the file with MADV_RANDOM so that faulting in one
+//      column does not read ahead into its neighbours, then explicitly
+//      prefetches (MADV_WILLNEED) only the chunks of the projected
+//      columns. Columns a pipeline does not select are never read from
+//      disk.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_COLUMNAR_HPP
+#define GCOMB_COLUMNAR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "algebraic_generator.hpp"
+#include "combinators.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    constexpr char columnar_magic[8] = {'G','C','O','M','B','C','O','L'};
+    constexpr std::uint32_t columnar_version = 1;
+    constexpr std::size_t columnar_align = 4096;
+
+    enum class column_kind : std::uint32_t
+    {
+        opaque   = 0,
+        signed_  = 1,
+        unsigned_= 2,
+        floating = 3
+    };
+
+    template <typename T>
+    constexpr column_kind kind_of (void) noexcept
+    {
+        return std::is_floating_point<T>::value ? column_kind::floating :
+               std::is_integral<T>::value ?
+                   (std::is_signed<T>::value ? column_kind::signed_
+                                             : column_kind::unsigned_) :
+               column_kind::opaque;
+    }
+
+    template <typename T>
+    using has_stats = std::integral_constant<bool,
+        std::is_arithmetic<T>::value && sizeof (T) <= 8>;
+
+    struct columnar_header
+    {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t ncols;
+        std::uint64_t nrows;
+        std::uint64_t nblocks;
+        std::uint64_t index_offset;
+    };
+
+    struct column_desc
+    {
+        std::uint32_t elem_size;
+        column_kind   kind;
+    };
+
+    struct chunk_desc
+    {
+        std::uint64_t offset;
+        unsigned char min[8];
+        unsigned char max[8];
+    };
+
+    struct block_desc
+    {
+        std::uint64_t rows;
+        std::vector<chunk_desc> chunks;
+    };
+
+    using swallow = int[];
+
+    constexpr bool all_true (void) noexcept
+    {
+        return true;
+    }
+
+    template <typename ... Bools>
+    constexpr bool all_true (bool b, Bools ... bs) noexcept
+    {
+        return b && all_true (bs...);
+    }
+
+
+    template <typename T>
+    typename std::enable_if<has_stats<T>::value>::type
+        fill_stats (chunk_desc & c, std::vector<T> const& v)
+    {
+        auto const mm = std::minmax_element (v.begin (), v.end ());
+        std::memcpy (c.min, &*mm.first,  sizeof (T));
+        std::memcpy (c.max, &*mm.second, sizeof (T));
+    }
+
+    template <typename T>
+    typename std::enable_if<not has_stats<T>::value>::type
+        fill_stats (chunk_desc &, std::vector<T> const&)
+    {}
+
+
+    // the parsed index of a mapped columnar file
+    //
+    class columnar_file
+    {
+    public:
+        explicit columnar_file (std::string const& path)
+            : map (path)
+        {
+            if (map.size () < sizeof (columnar_header))
+                throw std::runtime_error ("gcomb: not a columnar file: " + path);
+
+            std::memcpy (&header, map.data (), sizeof header);
+            if (std::memcmp (header.magic, columnar_magic, 8) != 0 ||
+                header.version != columnar_version ||
+                header.index_offset < sizeof (columnar_header) ||
+                header.index_offset > map.size ())
+                throw std::runtime_error ("gcomb: not a columnar file: " + path);
+
+            map.advise (0, map.size (), MADV_RANDOM);
+
+            auto p   = map.data () + header.index_offset;
+            auto end = map.data () + map.size ();
+
+            auto const take = [&] (void * dst, std::size_t n)
+            {
+                if (static_cast<std::size_t> (end - p) < n)
+                    throw std::runtime_error ("gcomb: truncated columnar index");
+                std::memcpy (dst, p, n);
+                p += n;
+            };
+
+            // size the index from the header only once it is known to fit
+            auto const left = [&] (void) { return static_cast<std::uint64_t> (end - p); };
+
+            if (header.ncols == 0 || header.ncols > left () / sizeof (column_desc))
+                throw std::runtime_error ("gcomb: truncated columnar index");
+
+            cols.resize (header.ncols);
+            for (auto & c : cols)
+                take (&c, sizeof c);
+
+            auto const per_block = sizeof (std::uint64_t) +
+                std::uint64_t (header.ncols) * sizeof (chunk_desc);
+            if (header.nblocks > left () / per_block)
+                throw std::runtime_error ("gcomb: truncated columnar index");
+
+            blocks.resize (header.nblocks);
+            for (auto & b : blocks) {
+                take (&b.rows, sizeof b.rows);
+                b.chunks.resize (header.ncols);
+                for (std::size_t i = 0; i < b.chunks.size (); ++i) {
+                    auto & c = b.chunks[i];
+                    take (&c, sizeof c);
+
+                    // chunks lie between the header and the index
+                    auto const room = header.index_offset - c.offset;
+                    if (c.offset < sizeof (columnar_header) ||
+                        c.offset > header.index_offset ||
+                        (cols[i].elem_size && b.rows > room / cols[i].elem_size))
+                        throw std::runtime_error ("gcomb: not a columnar file: " + path);
+                }
+            }
+        }
+
+        template <typename T>
+        void check_column (std::size_t col) const
+        {
+            if (col >= cols.size ())
+                throw std::out_of_range ("gcomb: no such column");
+
+            auto const& c = cols[col];
+            if (c.elem_size != sizeof (T) ||
+                (c.kind != column_kind::opaque && c.kind != kind_of<T> ()))
+                throw std::invalid_argument
+                    ("gcomb: column type does not match the file");
+        }
+
+        template <typename T>
+        T const* chunk (std::size_t block, std::size_t col) const noexcept
+        {
+            return reinterpret_cast<T const*>
+                (map.data () + blocks[block].chunks[col].offset);
+        }
+
+        void prefetch (std::size_t block, std::size_t col) const noexcept
+        {
+            map.advise (blocks[block].chunks[col].offset,
+                        blocks[block].rows * cols[col].elem_size,
+                        MADV_WILLNEED);
+        }
+
+        mapped_file map;
+        columnar_header header;
+        std::vector<column_desc> cols;
+        std::vector<block_desc> blocks;
+    };
+} // namespace detail
+
+    template <typename T, typename ... Ts>
+    class columnar_writer
+    {
+    public:
+        using row_type = std::tuple<T, Ts...>;
+
+        static constexpr std::size_t ncols = 1 + sizeof... (Ts);
+
+        explicit columnar_writer (std::string const& path,
+                                  std::size_t block_rows = 1 << 16)
+            : fd (detail::open_or_throw
+                    (path, O_WRONLY | O_CREAT | O_TRUNC)),
+              block_rows (block_rows ? block_rows : 1),
+              offset (detail::columnar_align), nrows (0), closed (false)
+        {
+            static_assert (std::is_trivially_copyable<T>::value &&
+                detail::all_true (std::is_trivially_copyable<Ts>::value...),
+                "columns must be trivially copyable");
+
+            reserve (typename detail::seq_gen<ncols>::type {});
+        }
+
+        columnar_writer (columnar_writer const&) = delete;
+        columnar_writer & operator= (columnar_writer const&) = delete;
+
+        // (not move assignable: that would have to finish the file
+        // being replaced, which may fail)
+        //
+        columnar_writer (columnar_writer && other) noexcept
+            : fd (std::move (other.fd)), block_rows (other.block_rows),
+              offset (other.offset), nrows (other.nrows), closed (other.closed),
+              buffers (std::move (other.buffers)), blocks (std::move (other.blocks))
+        {
+            other.closed = true;
+        }
+
+        // the header is only written by close (); a writer destroyed
+        // without one leaves it zeroed, so readers reject the file
+        // rather than take a failed export for a complete one
+        //
+        ~columnar_writer (void) noexcept = default;
+
+        void operator() (row_type const& row)
+        {
+            append (row, typename detail::seq_gen<ncols>::type {});
+            if (std::get<0> (buffers).size () == block_rows)
+                flush ();
+        }
+
+        void push (T const& t, Ts const& ... ts)
+        {
+            (*this) (row_type (t, ts...));
+        }
+
+        std::uint64_t rows (void) const noexcept
+        {
+            return nrows + std::get<0> (buffers).size ();
+        }
+
+        // write the final block, the index and the header
+        //
+        void close (void)
+        {
+            if (closed)
+                return;
+            closed = true;
+
+            flush ();
+
+            std::vector<char> index;
+            auto const put = [&index] (void const* p, std::size_t n)
+            {
+                auto const c = static_cast<char const*> (p);
+                index.insert (index.end (), c, c + n);
+            };
+
+            put_columns (put, typename detail::seq_gen<ncols>::type {});
+
+            for (auto const& b : blocks) {
+                put (&b.rows, sizeof b.rows);
+                for (auto const& c : b.chunks)
+                    put (&c, sizeof c);
+            }
+
+            seek (offset);
+            detail::write_full (fd.fd, index.data (), index.size ());
+
+            detail::columnar_header h;
+            std::memcpy (h.magic, detail::columnar_magic, 8);
+            h.version      = detail::columnar_version;
+            h.ncols        = static_cast<std::uint32_t> (ncols);
+            h.nrows        = nrows;
+            h.nblocks      = blocks.size ();
+            h.index_offset = offset;
+
+            seek (0);
+            detail::write_full
+                (fd.fd, reinterpret_cast<char const*> (&h), sizeof h);
+        }
+
+    private:
+        template <std::size_t ... S>
+        void reserve (detail::seq<S...>)
+        {
+            (void) detail::swallow
+                {0, (std::get<S> (buffers).reserve (block_rows), 0)...};
+        }
+
+        template <std::size_t ... S>
+        void append (row_type const& row, detail::seq<S...>)
+        {
+            (void) detail::swallow
+                {0, (std::get<S> (buffers).push_back (std::get<S> (row)), 0)...};
+        }
+
+        template <typename Put, std::size_t ... S>
+        void put_columns (Put && put, detail::seq<S...>)
+        {
+            detail::column_desc const descs[] = {
+                detail::column_desc {
+                    sizeof (typename std::tuple_element<S, row_type>::type),
+                    detail::kind_of
+                        <typename std::tuple_element<S, row_type>::type> ()}...
+            };
+            put (descs, sizeof descs);
+        }
+
+        void seek (std::uint64_t off)
+        {
+            if (::lseek (fd.fd, static_cast<off_t> (off), SEEK_SET) < 0)
+                detail::throw_errno ("lseek");
+        }
+
+        template <typename U>
+        void write_chunk (detail::block_desc & b, std::size_t col,
+                          std::vector<U> & v)
+        {
+            auto & c = b.chunks[col];
+            c.offset = offset;
+            detail::fill_stats (c, v);
+
+            seek (offset);
+            auto const bytes = v.size () * sizeof (U);
+            detail::write_full
+                (fd.fd, reinterpret_cast<char const*> (v.data ()), bytes);
+
+            offset += (bytes + detail::columnar_align - 1) /
+                detail::columnar_align * detail::columnar_align;
+            v.clear ();
+        }
+
+        template <std::size_t ... S>
+        void write_block (detail::block_desc & b, detail::seq<S...>)
+        {
+            (void) detail::swallow
+                {0, (write_chunk (b, S, std::get<S> (buffers)), 0)...};
+        }
+
+        void flush (void)
+        {
+            auto const n = std::get<0> (buffers).size ();
+            if (n == 0)
+                return;
+
+            detail::block_desc b;
+            b.rows = n;
+            b.chunks.resize (ncols, detail::chunk_desc {0, {}, {}});
+            write_block (b, typename detail::seq_gen<ncols>::type {});
+
+            blocks.push_back (std::move (b));
+            nrows += n;
+        }
+
+        detail::fd_handle fd;
+        std::size_t block_rows;
+        std::uint64_t offset;
+        std::uint64_t nrows;
+        bool closed;
+        std::tuple<std::vector<T>, std::vector<Ts>...> buffers;
+        std::vector<detail::block_desc> blocks;
+    };
+
+
+    // drain a bounded generator of rows into a columnar file,
+    // returning the number of rows written.
+    //
+    template <typename T, typename ... Ts>
+    std::uint64_t write_columnar
+        (std::string const& path,
+         algebraic_generator<std::tuple<T, Ts...>, bot_t> const& g,
+         std::size_t block_rows = 1 << 16)
+    {
+        columnar_writer<T, Ts...> w (path, block_rows);
+
+        for (;;) {
+            auto const row = g ();
+            if (is_bot (row))
+                break;
+            w (row.template value<std::tuple<T, Ts...>> ());
+        }
+
+        w.close ();
+        return w.rows ();
+    }
+
+
+    // write the next n rows of an (infinite) generator of rows
+    //
+    template <typename T, typename ... Ts>
+    std::uint64_t write_columnar
+        (std::string const& path,
+         generator<std::tuple<T, Ts...>> const& g,
+         std::uint64_t n,
+         std::size_t block_rows = 1 << 16)
+    {
+        columnar_writer<T, Ts...> w (path, block_rows);
+
+        while (n--)
+            w (g ());
+
+        w.close ();
+        return w.rows ();
+    }
+
+
+    class columnar_reader
+    {
+    public:
+        explicit columnar_reader (std::string const& path)
+            : file (std::make_shared<detail::columnar_file> (path))
+        {}
+
+        std::uint64_t rows    (void) const noexcept { return file->header.nrows; }
+        std::size_t   columns (void) const noexcept { return file->cols.size (); }
+        std::size_t   blocks  (void) const noexcept { return file->blocks.size (); }
+
+        // restrict subsequent selections to blocks whose statistics for
+        // column col may contain values in [lo, hi]. Rows of surviving
+        // blocks are not filtered individually.
+        //
+        template <typename T>
+        columnar_reader & where (std::size_t col, T lo, T hi)
+        {
+            static_assert (detail::has_stats<T>::value,
+                "block statistics are only kept for arithmetic columns");
+
+            file->check_column<T> (col);
+
+            auto const f = file;
+            filters.push_back ([f,col,lo,hi] (std::size_t b) -> bool
+            {
+                T mn, mx;
+                std::memcpy (&mn, f->blocks[b].chunks[col].min, sizeof (T));
+                std::memcpy (&mx, f->blocks[b].chunks[col].max, sizeof (T));
+                return not (mx < lo || hi < mn);
+            });
+
+            return *this;
+        }
+
+        // per block views of the selected columns, used in place from
+        // the mapping; e.g.
+        //
+        //      r.select_blocks<std::uint64_t, double> (0, 3)
+        //
+        // yields std::tuple<view<std::uint64_t>, view<double>>.
+        //
+        template <typename T, typename ... Ts, typename ... Cols>
+        algebraic_generator<std::tuple<view<T>, view<Ts>...>, bot_t>
+            select_blocks (Cols ... cols) const
+        {
+            static_assert (sizeof... (Cols) == 1 + sizeof... (Ts),
+                "one column index per selected type");
+
+            constexpr std::size_t n = 1 + sizeof... (Ts);
+            std::array<std::size_t, n> const idx
+                {{static_cast<std::size_t> (cols)...}};
+
+            check<T, Ts...> (idx, typename detail::seq_gen<n>::type {});
+
+            using R = std::tuple<view<T>, view<Ts>...>;
+            using A = algebraic::algebraic<R, bot_t>;
+
+            auto const f  = file;
+            auto const bs = surviving ();
+            std::size_t next = 0;
+
+            if (not bs.empty ())
+                prefetch (*f, bs[0], idx);
+
+            return algebraic_generator<R, bot_t>
+                ([f,bs,idx,next] (void) mutable -> A
+                {
+                    if (next == bs.size ())
+                        return A (bot_t{});
+
+                    auto const b = bs[next++];
+                    if (next < bs.size ())
+                        prefetch (*f, bs[next], idx);
+
+                    return A (make_row<T, Ts...>
+                        (*f, b, idx, typename detail::seq_gen<n>::type {}));
+                });
+        }
+
+        // rows of the selected columns as tuples, ready for the
+        // tuple unpacking bind.
+        //
+        template <typename T, typename ... Ts, typename ... Cols>
+        algebraic_generator<std::tuple<T, Ts...>, bot_t>
+            select (Cols ... cols) const
+        {
+            constexpr std::size_t n = 1 + sizeof... (Ts);
+
+            using B = std::tuple<view<T>, view<Ts>...>;
+            using R = std::tuple<T, Ts...>;
+            using A = algebraic::algebraic<R, bot_t>;
+
+            auto const bl = select_blocks<T, Ts...> (cols...);
+            B cur;
+            std::size_t i = 0, count = 0;
+
+            return algebraic_generator<R, bot_t>
+                ([bl,cur,i,count] (void) mutable -> A
+                {
+                    while (i == count) {
+                        auto const next = bl ();
+                        if (is_bot (next))
+                            return A (bot_t{});
+
+                        cur   = next.template value<B> ();
+                        count = std::get<0> (cur).size ();
+                        i     = 0;
+                    }
+
+                    return A (row_at (cur, i++, typename detail::seq_gen<n>::type {}));
+                });
+        }
+
+        template <typename T>
+        algebraic_generator<T, bot_t> column (std::size_t col) const
+        {
+            auto const rows = select<T> (col);
+
+            using A = algebraic::algebraic<T, bot_t>;
+            return algebraic_generator<T, bot_t>
+                ([rows] (void) -> A
+                {
+                    auto const r = rows ();
+                    if (is_bot (r))
+                        return A (bot_t{});
+                    return A (std::get<0> (r.template value<std::tuple<T>> ()));
+                });
+        }
+
+    private:
+        template <typename ... Ts, std::size_t N, std::size_t ... S>
+        void check (std::array<std::size_t, N> const& idx,
+                    detail::seq<S...>) const
+        {
+            (void) detail::swallow
+                {0, (file->check_column<Ts> (idx[S]), 0)...};
+        }
+
+        template <std::size_t N>
+        static void prefetch (detail::columnar_file const& f, std::size_t b,
+                              std::array<std::size_t, N> const& idx) noexcept
+        {
+            for (auto const c : idx)
+                f.prefetch (b, c);
+        }
+
+        template <typename ... Ts, std::size_t N, std::size_t ... S>
+        static std::tuple<view<Ts>...> make_row
+            (detail::columnar_file const& f, std::size_t b,
+             std::array<std::size_t, N> const& idx, detail::seq<S...>)
+        {
+            auto const rows = static_cast<std::size_t> (f.blocks[b].rows);
+            return std::tuple<view<Ts>...>
+                (make_view (f.chunk<Ts> (b, idx[S]), rows)...);
+        }
+
+        template <typename ... Ts, std::size_t ... S>
+        static std::tuple<Ts...> row_at
+            (std::tuple<view<Ts>...> const& cur, std::size_t i,
+             detail::seq<S...>)
+        {
+            return std::tuple<Ts...> (std::get<S> (cur)[i]...);
+        }
+
+        std::vector<std::size_t> surviving (void) const
+        {
+            std::vector<std::size_t> bs;
+            for (std::size_t b = 0; b < file->blocks.size (); ++b) {
+                bool keep = true;
+                for (auto const& f : filters)
+                    keep = keep && f (b);
+                if (keep)
+                    bs.push_back (b);
+            }
+            return bs;
+        }
+
+        std::shared_ptr<detail::columnar_file> file;
+        std::vector<std::function<bool (std::size_t)>> filters;
+    };
+} // namespace gcomb
+
+#endif // ifndef GCOMB_COLUMNAR_HPP
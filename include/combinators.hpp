@@ -11,11 +11,15 @@
 #ifndef GCOMB_COMBINATORS_HPP
 #define GCOMB_COMBINATORS_HPP
 
+#include <cstddef>
+#include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "algebraic_generator.hpp"
 #include "generator.hpp"
+#include "view.hpp"
 
 namespace gcomb
 {
@@ -64,17 +68,19 @@ namespace detail
 
     // call a function on a tuple of it's arguments
     //
-    template <typename F, typename Tup>
+    template <typename F, typename Tup,
+        typename S = typename seq_gen
+            <std::tuple_size<typename std::decay<Tup>::type>::value>::type>
     auto call (F&& f, Tup&& args)
         -> decltype(call_impl
             (std::forward<F>(f),
              std::forward<Tup>(args),
-             seq_gen<std::tuple_size<Tup>::value>::type))
+             S {}))
     {
         return call_impl
             (std::forward<F>(f),
              std::forward<Tup>(args),
-             seq_gen<std::tuple_size<Tup>::value>::type);
+             S {});
     }
 } // namespace detail
 
@@ -178,7 +184,27 @@ namespace detail
     generator<U> bind (F&& f, generator<T> const& g, generator<Ts> const&... gs)
         noexcept
     {
-        return bind (f, braid (g, gs...));
+        return gcomb::bind (f, tie (g, gs...));
+    }
+
+
+    // unpack the tuples of a bounded generator, reverting to bot with it
+    //
+    template <typename F, typename T, typename ... Ts,
+        typename U = typename std::result_of<F(T, Ts...)>::type>
+    algebraic_generator<U, bot_t>
+        bind (F&& f, algebraic_generator<std::tuple<T,Ts...>, bot_t> const& g)
+    {
+        using A = algebraic::algebraic<U, bot_t>;
+
+        return algebraic_generator<U, bot_t>
+            ([f,g] (void) -> A
+            {
+                auto const v = g ();
+                if (is_bot (v))
+                    return A (bot_t{});
+                return A (detail::call (f, v.template value<std::tuple<T,Ts...>> ()));
+            });
     }
 
 
@@ -193,6 +219,260 @@ namespace detail
                 return n ? (--n, A (g())) : A (bot_t{});
             });
     }
+
+
+    // the inverse of batching: produce the elements of each view
+    // in turn, reverting to bot once the batches run out.
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t>
+        flatten (algebraic_generator<view<T>, bot_t> const& batches)
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        view<T> cur {nullptr, 0};
+        std::size_t i = 0;
+
+        return algebraic_generator<T, bot_t>
+            ([batches,cur,i] (void) mutable -> A
+            {
+                while (i == cur.count) {
+                    auto const next = batches ();
+                    if (is_bot (next))
+                        return A (bot_t{});
+
+                    cur = next.template value<view<T>> ();
+                    i = 0;
+                }
+
+                return A (cur[i++]);
+            });
+    }
+
+namespace detail
+{
+    // k slots, each value written twice (at i and at i + k) so that the
+    // latest k values are always contiguous, oldest first
+    //
+    template <typename T>
+    struct mirror_ring
+    {
+        explicit mirror_ring (std::size_t k)
+            : buf (2 * k), k (k), pos (0), filled (0)
+        {}
+
+        void push (T const& value)
+        {
+            buf[pos]     = value;
+            buf[pos + k] = value;
+            pos = pos + 1 == k ? 0 : pos + 1;
+            if (filled < k)
+                ++filled;
+        }
+
+        // values needed before the next window is ready
+        std::size_t wanted (std::size_t stride) const noexcept
+        {
+            return filled < k ? k - filled : stride;
+        }
+
+        view<T> last (void) const noexcept
+        {
+            return make_view (buf.data () + pos, k);
+        }
+
+        std::vector<T> buf;
+        std::size_t k;
+        std::size_t pos;
+        std::size_t filled;
+    };
+
+
+    // the last k values; exchange stores a new one and returns the
+    // value k places before it
+    //
+    template <typename T>
+    struct lag_ring
+    {
+        explicit lag_ring (std::size_t k) : buf (k), pos (0), filled (0) {}
+
+        bool full (void) const noexcept { return filled == buf.size (); }
+
+        void push (T const& value)
+        {
+            buf[filled++] = value;
+        }
+
+        T exchange (T value)
+        {
+            if (buf.empty ())
+                return value;
+
+            std::swap (buf[pos], value);
+            pos = pos + 1 == buf.size () ? 0 : pos + 1;
+            return value;
+        }
+
+        std::vector<T> buf;
+        std::size_t pos;
+        std::size_t filled;
+    };
+
+
+    template <typename T>
+    struct chunk_buffer
+    {
+        explicit chunk_buffer (std::size_t n) : buf (n), done (false) {}
+
+        std::vector<T> buf;
+        bool done;
+    };
+} // namespace detail
+
+    // sliding windows of the last k values, advancing by stride values
+    // between windows; each window is a view (valid until the next call)
+    // into a ring buffer held by the generator.
+    //
+    template <typename T>
+    generator<view<T>> window (generator<T> const& g, std::size_t k,
+                               std::size_t stride = 1)
+    {
+        detail::mirror_ring<T> ring (k ? k : 1);
+        stride = stride ? stride : 1;
+
+        return generator<view<T>>
+            ([g,ring,stride] (void) mutable -> view<T>
+            {
+                for (auto n = ring.wanted (stride); n; --n)
+                    ring.push (g ());
+                return ring.last ();
+            });
+    }
+
+
+    // sliding windows over a bounded generator; a final window that
+    // cannot be filled is dropped.
+    //
+    template <typename T>
+    algebraic_generator<view<T>, bot_t>
+        window (algebraic_generator<T, bot_t> const& g, std::size_t k,
+                std::size_t stride = 1)
+    {
+        using A = algebraic::algebraic<view<T>, bot_t>;
+
+        detail::mirror_ring<T> ring (k ? k : 1);
+        stride = stride ? stride : 1;
+
+        return algebraic_generator<view<T>, bot_t>
+            ([g,ring,stride] (void) mutable -> A
+            {
+                for (auto n = ring.wanted (stride); n; --n) {
+                    auto const v = g ();
+                    if (is_bot (v))
+                        return A (bot_t{});
+                    ring.push (v.template value<T> ());
+                }
+                return A (ring.last ());
+            });
+    }
+
+
+    // consecutive, non-overlapping runs of n values, as views (valid
+    // until the next call) into one reused buffer.
+    //
+    template <typename T>
+    generator<view<T>> chunk (generator<T> const& g, std::size_t n)
+    {
+        detail::chunk_buffer<T> st (n ? n : 1);
+
+        return generator<view<T>>
+            ([g,st] (void) mutable -> view<T>
+            {
+                for (auto & x : st.buf)
+                    x = g ();
+                return make_view (static_cast<T const*> (st.buf.data ()), st.buf.size ());
+            });
+    }
+
+
+    // chunks of a bounded generator; the last may be shorter than n.
+    //
+    template <typename T>
+    algebraic_generator<view<T>, bot_t>
+        chunk (algebraic_generator<T, bot_t> const& g, std::size_t n)
+    {
+        using A = algebraic::algebraic<view<T>, bot_t>;
+
+        detail::chunk_buffer<T> st (n ? n : 1);
+
+        return algebraic_generator<view<T>, bot_t>
+            ([g,st] (void) mutable -> A
+            {
+                std::size_t i = 0;
+                while (not st.done && i < st.buf.size ()) {
+                    auto const v = g ();
+                    if (is_bot (v))
+                        st.done = true;
+                    else
+                        st.buf[i++] = v.template value<T> ();
+                }
+
+                if (i == 0)
+                    return A (bot_t{});
+                return A (make_view (static_cast<T const*> (st.buf.data ()), i));
+            });
+    }
+
+    // (x[i], x[i-k]) for every i >= k, from a single pass over g and a
+    // ring of the last k values; gcomb::bind (f, lag (g, k)) calls f (x, x_k).
+    //
+    template <typename T>
+    generator<std::tuple<T, T>> lag (generator<T> const& g, std::size_t k)
+    {
+        detail::lag_ring<T> ring (k);
+
+        return generator<std::tuple<T, T>>
+            ([g,ring] (void) mutable -> std::tuple<T, T>
+            {
+                while (not ring.full ())
+                    ring.push (g ());
+
+                auto x = g ();
+                auto old = ring.exchange (x);
+                return std::tuple<T, T> (std::move (x), std::move (old));
+            });
+    }
+
+
+    // lagged pairs of a bounded generator, reverting to bot with it
+    //
+    template <typename T>
+    algebraic_generator<std::tuple<T, T>, bot_t>
+        lag (algebraic_generator<T, bot_t> const& g, std::size_t k)
+    {
+        using A = algebraic::algebraic<std::tuple<T, T>, bot_t>;
+
+        detail::lag_ring<T> ring (k);
+
+        return algebraic_generator<std::tuple<T, T>, bot_t>
+            ([g,ring] (void) mutable -> A
+            {
+                for (;;) {
+                    auto const v = g ();
+                    if (is_bot (v))
+                        return A (bot_t{});
+
+                    auto x = v.template value<T> ();
+                    if (not ring.full ()) {
+                        ring.push (x);
+                        continue;
+                    }
+
+                    auto old = ring.exchange (x);
+                    return A (std::tuple<T, T> (std::move (x), std::move (old)));
+                }
+            });
+    }
 } // namspace gcomb
 
 #endif // ifndef GCOMB_COMBINATORS
@@ -0,0 +1,276 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// coroutine : generators written as C++20 coroutine bodies.
+//
+//      gcomb::co_generator<std::uint64_t> fibonacci (void)
+//      {
+//          std::uint64_t a = 0, b = 1;
+//          for (;;) {
+//              co_yield a;
+//              a = std::exchange (b, a + b);
+//          }
+//      }
+//
+//      gcomb::generator<std::uint64_t> fib = fibonacci ();
+//      auto first = gcomb::bound (fib, 10);
+//
+// note:
+//      A co_generator converts into a generator<T> (an infinite stream;
+//      running off the end of the body is an error) or, through
+//      from_coroutine, into an algebraic_generator<T, bot_t> that reverts
+//      to bot when the body returns. Either can then be used with every
+//      other combinator. An exception escaping the body is rethrown to
+//      the consumer.
+//
+//      co_yield hands out a pointer to the yielded object, which lives
+//      in the suspended frame; the consumer copies it once.
+//
+//      Coroutine frames are allocated through the promise's operator new
+//      from a per-thread pool of recycled blocks (in size classes of
+//      frame_pool::granule bytes), so creating short-lived generators in
+//      a loop does not hit the global allocator once the pool is warm.
+//      Blocks freed on another thread join that thread's pool.
+//
+//      Only available when compiling as C++20 (or later) with coroutine
+//      support; otherwise this header is empty.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_COROUTINE_HPP
+#define GCOMB_COROUTINE_HPP
+
+#if defined (__cpp_impl_coroutine) && __has_include (<coroutine>)
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    // per-thread free lists of coroutine frames
+    //
+    class frame_pool
+    {
+    public:
+        static constexpr std::size_t granule  = 64;
+        static constexpr std::size_t classes  = 64;     // up to 4 KiB
+        static constexpr std::size_t retained = 64;     // blocks kept per class
+
+        static void * allocate (std::size_t n)
+        {
+            auto const c = size_class (n);
+            if (c < classes) {
+                auto & list = local ().lists[c];
+                if (list.head) {
+                    auto const b = list.head;
+                    list.head = b->next;
+                    --list.count;
+                    return b;
+                }
+                return ::operator new ((c + 1) * granule);
+            }
+            return ::operator new (n);
+        }
+
+        static void deallocate (void * p, std::size_t n) noexcept
+        {
+            auto const c = size_class (n);
+            if (c < classes) {
+                auto & list = local ().lists[c];
+                if (list.count < retained) {
+                    auto const b = static_cast<block *> (p);
+                    b->next = list.head;
+                    list.head = b;
+                    ++list.count;
+                    return;
+                }
+            }
+            ::operator delete (p);
+        }
+
+    private:
+        struct block { block * next; };
+
+        struct free_list
+        {
+            block * head = nullptr;
+            std::size_t count = 0;
+        };
+
+        struct lists_t
+        {
+            ~lists_t (void) noexcept
+            {
+                for (auto & l : lists)
+                    while (l.head)
+                        ::operator delete (std::exchange (l.head, l.head->next));
+            }
+
+            free_list lists[classes];
+        };
+
+        static std::size_t size_class (std::size_t n) noexcept
+        {
+            return n ? (n - 1) / granule : 0;
+        }
+
+        static lists_t & local (void) noexcept
+        {
+            thread_local lists_t pool;
+            return pool;
+        }
+    };
+} // namespace detail
+
+    // the return type of a generator coroutine body
+    //
+    template <typename T>
+    class co_generator
+    {
+    public:
+        struct promise_type
+        {
+            T const* current = nullptr;
+            std::exception_ptr error;
+
+            co_generator get_return_object (void) noexcept
+            {
+                return co_generator (handle::from_promise (*this));
+            }
+
+            std::suspend_always initial_suspend (void) const noexcept { return {}; }
+            std::suspend_always final_suspend (void) const noexcept { return {}; }
+
+            std::suspend_always yield_value (T const& value) noexcept
+            {
+                current = std::addressof (value);
+                return {};
+            }
+
+            void return_void (void) const noexcept {}
+
+            void unhandled_exception (void) noexcept
+            {
+                error = std::current_exception ();
+            }
+
+            static void * operator new (std::size_t n)
+            {
+                return detail::frame_pool::allocate (n);
+            }
+
+            static void operator delete (void * p, std::size_t n) noexcept
+            {
+                detail::frame_pool::deallocate (p, n);
+            }
+        };
+
+        using handle = std::coroutine_handle<promise_type>;
+
+        co_generator (co_generator && other) noexcept
+            : h (std::exchange (other.h, nullptr))
+        {}
+
+        co_generator & operator= (co_generator && other) noexcept
+        {
+            if (this != &other) {
+                if (h)
+                    h.destroy ();
+                h = std::exchange (other.h, nullptr);
+            }
+            return *this;
+        }
+
+        ~co_generator (void) noexcept
+        {
+            if (h)
+                h.destroy ();
+        }
+
+        // run the body to its next co_yield; false once it has returned
+        //
+        bool next (void)
+        {
+            if (not h || h.done ())
+                return false;
+
+            h.resume ();
+
+            if (h.done ()) {
+                if (h.promise ().error)
+                    std::rethrow_exception (std::exchange (h.promise ().error, nullptr));
+                return false;
+            }
+            return true;
+        }
+
+        // the value of the last co_yield (valid until the next call to next)
+        //
+        T const& value (void) const noexcept
+        {
+            return *h.promise ().current;
+        }
+
+        // an infinite generator over the body
+        //
+        operator generator<T> (void) &&
+        {
+            auto const st = std::make_shared<co_generator> (std::move (*this));
+
+            return generator<T>
+                ([st] (void) -> T
+                {
+                    if (not st->next ())
+                        throw std::logic_error ("gcomb: infinite coroutine returned");
+                    return st->value ();
+                });
+        }
+
+        operator algebraic_generator<T, bot_t> (void) &&
+        {
+            using A = algebraic::algebraic<T, bot_t>;
+
+            auto const st = std::make_shared<co_generator> (std::move (*this));
+
+            return algebraic_generator<T, bot_t>
+                ([st] (void) -> A
+                {
+                    if (not st->next ())
+                        return A (bot_t{});
+                    return A (st->value ());
+                });
+        }
+
+    private:
+        explicit co_generator (handle h) noexcept : h (h) {}
+
+        handle h;
+    };
+
+
+    // a bounded generator over a coroutine body, reverting to bot once
+    // the body returns.
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t> from_coroutine (co_generator<T> co)
+    {
+        return algebraic_generator<T, bot_t> (std::move (co));
+    }
+} // namespace gcomb
+
+#endif // coroutine support
+
+#endif // ifndef GCOMB_COROUTINE_HPP
@@ -0,0 +1,390 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// distinct : dropping repeated values.
+//
+//      // first occurrences of about 2 billion ids, ~0.1% wrongly dropped
+//      auto fresh = gcomb::distinct_approx (ids, std::size_t (2) << 30, 0.001);
+//
+//      // collapse runs: 1 1 2 2 2 1 -> 1 2 1
+//      auto changes = gcomb::distinct_adjacent (readings);
+//
+// note:
+//      distinct_approx remembers the values it has passed in a blocked
+//      Bloom filter sized for expected_n values at false positive rate
+//      fp_rate. A false positive makes it drop a value it has never
+//      seen; a repeat is never let through. Past expected_n values the
+//      false positive rate grows.
+//
+//      Each block of the filter is one 64-byte cache line of eight
+//      64-bit words, and a value sets one bit in each word of the block
+//      its hash picks, so a lookup touches a single cache line (with
+//      AVX2, tested and set with two 256-bit operations). Confining a
+//      value's bits to one block raises the false positive rate a little
+//      over a classic Bloom filter's; the filter is sized for the target
+//      rate with that accounted for, which costs about 11 bits per value
+//      at 1% and 16 at 0.1%.
+//
+//      Copies of a distinct_approx generator share its filter (which may
+//      be gigabytes), so a value passed by one is dropped by the others.
+//
+//      distinct_adjacent drops values equal to the one before, and holds
+//      just that one.
+//
+//      Both accept a stream of batches (views) too, and then yield
+//      batches of what is kept, compacted into one reused buffer (valid
+//      until the next call); batches left empty are not yielded.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_DISTINCT_HPP
+#define GCOMB_DISTINCT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "random.hpp"
+#include "sketch.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+    // a Bloom filter of cache-line blocks
+    //
+    template <typename T, typename Hash = std::hash<T>>
+    class bloom_filter
+    {
+    public:
+        bloom_filter (std::size_t expected_n, double fp_rate, Hash hash = Hash ())
+            : hash (hash)
+        {
+            if (not (fp_rate > 0.0 && fp_rate < 1.0))
+                throw std::invalid_argument ("gcomb: bloom_filter fp_rate must be in (0, 1)");
+
+            // classic sizing for 8 bits set per value, plus a tenth for the
+            // blocking
+            auto const n = static_cast<double> (expected_n ? expected_n : 1);
+            auto const bits = 1.1 * -8.0 * n / std::log1p (-std::pow (fp_rate, 1.0 / 8.0));
+
+            blocks = static_cast<std::size_t> (std::ceil (bits / 512.0));
+            words.assign (8 * blocks + 8, 0);
+        }
+
+        // the blocks need not sit at the same offset from a cache line in
+        // the copy's words
+        //
+        bloom_filter (bloom_filter const& other)
+            : words (other.words.size (), 0), blocks (other.blocks), hash (other.hash)
+        {
+            std::copy (other.words.data () + other.start (),
+                       other.words.data () + other.start () + 8 * blocks,
+                       words.data () + start ());
+        }
+
+        bloom_filter (bloom_filter &&) = default;
+
+        bloom_filter & operator= (bloom_filter const& other)
+        {
+            return *this = bloom_filter (other);
+        }
+
+        bloom_filter & operator= (bloom_filter &&) = default;
+
+        // add value; true if it was not (as far as the filter can tell)
+        // there before
+        //
+        bool insert (T const& value) noexcept
+        {
+            auto const h = detail::sketch_mix (hash (value));
+            auto const f = fields (h);
+            auto * b = words.data () + block (h);
+
+        #if defined(__AVX2__)
+            auto const lo = bit_masks (f, 0);
+            auto const hi = bit_masks (f, 24);
+            auto * p = reinterpret_cast<__m256i *> (b);
+
+            auto const a = _mm256_load_si256 (p);
+            auto const c = _mm256_load_si256 (p + 1);
+            bool const had = _mm256_testc_si256 (a, lo) && _mm256_testc_si256 (c, hi);
+
+            _mm256_store_si256 (p,     _mm256_or_si256 (a, lo));
+            _mm256_store_si256 (p + 1, _mm256_or_si256 (c, hi));
+            return not had;
+        #else
+            std::uint64_t missing = 0;
+            for (int i = 0; i < 8; ++i) {
+                auto const bit = std::uint64_t (1) << ((f >> (6 * i)) & 63);
+                missing |= bit & ~b[i];
+                b[i] |= bit;
+            }
+            return missing != 0;
+        #endif
+        }
+
+        bool contains (T const& value) const noexcept
+        {
+            auto const h = detail::sketch_mix (hash (value));
+            auto const f = fields (h);
+            auto const* b = words.data () + block (h);
+
+            for (int i = 0; i < 8; ++i)
+                if (not (b[i] & (std::uint64_t (1) << ((f >> (6 * i)) & 63))))
+                    return false;
+            return true;
+        }
+
+        // memory used, in bytes
+        //
+        std::size_t size (void) const noexcept
+        {
+            return 64 * blocks;
+        }
+
+    private:
+        // offset in words of the first cache line boundary
+        //
+        std::size_t start (void) const noexcept
+        {
+            auto const addr = reinterpret_cast<std::uintptr_t> (words.data ());
+            return (64 - addr % 64) % 64 / 8;
+        }
+
+        // offset in words of the block for h, picked by its top bits
+        //
+        std::size_t block (std::uint64_t h) const noexcept
+        {
+            return start () + 8 * detail::mulhi64 (h, blocks);
+        }
+
+        // eight 6-bit fields choosing the bit set in each word of the
+        // block, from a second mix of h: taken from h itself they would
+        // share bits with the block index once there are over 2^16 blocks
+        //
+        static std::uint64_t fields (std::uint64_t h) noexcept
+        {
+            return detail::sketch_mix (h ^ 0x5851f42d4c957f2dull);
+        }
+
+    #if defined(__AVX2__)
+        // one bit in each of four words, from the fields f at shift
+        //
+        static __m256i bit_masks (std::uint64_t f, int shift) noexcept
+        {
+            auto const shifts = _mm256_srlv_epi64
+                (_mm256_set1_epi64x (static_cast<long long> (f >> shift)),
+                 _mm256_set_epi64x (18, 12, 6, 0));
+            return _mm256_sllv_epi64 (_mm256_set1_epi64x (1),
+                                      _mm256_and_si256 (shifts, _mm256_set1_epi64x (63)));
+        }
+    #endif
+
+        std::vector<std::uint64_t> words;
+        std::size_t blocks;
+        Hash hash;
+    };
+
+namespace detail
+{
+    template <typename T>
+    struct adjacent_state
+    {
+        T last;
+        bool started;
+    };
+
+
+    template <typename T>
+    struct adjacent_batch_state
+    {
+        adjacent_state<T> prev;
+        std::vector<T> buf;
+    };
+} // namespace detail
+
+    // first occurrences of the values of a bounded generator, up to the
+    // filter's false positives
+    //
+    template <typename T, typename Hash = std::hash<T>>
+    algebraic_generator<T, bot_t>
+        distinct_approx (algebraic_generator<T, bot_t> const& g,
+                         std::size_t expected_n, double fp_rate = 0.01,
+                         Hash hash = Hash ())
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        auto const seen = std::make_shared<bloom_filter<T, Hash>> (expected_n, fp_rate, hash);
+
+        return algebraic_generator<T, bot_t>
+            ([g,seen] (void) -> A
+            {
+                for (;;) {
+                    auto const v = g ();
+                    if (is_bot (v))
+                        return A (bot_t{});
+                    if (seen->insert (v.template value<T> ()))
+                        return v;
+                }
+            });
+    }
+
+
+    // first occurrences of the values of an infinite generator
+    //
+    template <typename T, typename Hash = std::hash<T>>
+    generator<T> distinct_approx (generator<T> const& g,
+                                  std::size_t expected_n, double fp_rate = 0.01,
+                                  Hash hash = Hash ())
+    {
+        auto const seen = std::make_shared<bloom_filter<T, Hash>> (expected_n, fp_rate, hash);
+
+        return generator<T>
+            ([g,seen] (void) -> T
+            {
+                for (;;) {
+                    auto x = g ();
+                    if (seen->insert (x))
+                        return x;
+                }
+            });
+    }
+
+
+    // distinct_approx over a stream of batches
+    //
+    template <typename T, typename Hash = std::hash<T>>
+    algebraic_generator<view<T>, bot_t>
+        distinct_approx (algebraic_generator<view<T>, bot_t> const& batches,
+                         std::size_t expected_n, double fp_rate = 0.01,
+                         Hash hash = Hash ())
+    {
+        using A = algebraic::algebraic<view<T>, bot_t>;
+
+        auto const seen = std::make_shared<bloom_filter<T, Hash>> (expected_n, fp_rate, hash);
+        std::vector<T> buf;
+
+        return algebraic_generator<view<T>, bot_t>
+            ([batches,seen,buf] (void) mutable -> A
+            {
+                for (;;) {
+                    auto const v = batches ();
+                    if (is_bot (v))
+                        return A (bot_t{});
+
+                    buf.clear ();
+                    for (auto const& x : v.template value<view<T>> ())
+                        if (seen->insert (x))
+                            buf.push_back (x);
+
+                    if (not buf.empty ())
+                        return A (make_view (static_cast<T const*> (buf.data ()),
+                                             buf.size ()));
+                }
+            });
+    }
+
+
+    // drop values equal to the one before
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t> distinct_adjacent (algebraic_generator<T, bot_t> const& g)
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        detail::adjacent_state<T> st {};
+
+        return algebraic_generator<T, bot_t>
+            ([g,st] (void) mutable -> A
+            {
+                for (;;) {
+                    auto const v = g ();
+                    if (is_bot (v))
+                        return A (bot_t{});
+
+                    auto const& x = v.template value<T> ();
+                    if (st.started && x == st.last)
+                        continue;
+
+                    st.last = x;
+                    st.started = true;
+                    return v;
+                }
+            });
+    }
+
+
+    template <typename T>
+    generator<T> distinct_adjacent (generator<T> const& g)
+    {
+        detail::adjacent_state<T> st {};
+
+        return generator<T>
+            ([g,st] (void) mutable -> T
+            {
+                for (;;) {
+                    auto x = g ();
+                    if (st.started && x == st.last)
+                        continue;
+
+                    st.last = x;
+                    st.started = true;
+                    return x;
+                }
+            });
+    }
+
+
+    // distinct_adjacent over a stream of batches, carrying the last
+    // value across them
+    //
+    template <typename T>
+    algebraic_generator<view<T>, bot_t>
+        distinct_adjacent (algebraic_generator<view<T>, bot_t> const& batches)
+    {
+        using A = algebraic::algebraic<view<T>, bot_t>;
+
+        detail::adjacent_batch_state<T> st {};
+
+        return algebraic_generator<view<T>, bot_t>
+            ([batches,st] (void) mutable -> A
+            {
+                for (;;) {
+                    auto const v = batches ();
+                    if (is_bot (v))
+                        return A (bot_t{});
+
+                    auto & prev = st.prev;
+                    st.buf.clear ();
+
+                    for (auto const& x : v.template value<view<T>> ()) {
+                        if (prev.started && x == prev.last)
+                            continue;
+                        prev.last = x;
+                        prev.started = true;
+                        st.buf.push_back (x);
+                    }
+
+                    if (not st.buf.empty ())
+                        return A (make_view (static_cast<T const*> (st.buf.data ()),
+                                             st.buf.size ()));
+                }
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_DISTINCT_HPP
@@ -0,0 +1,213 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// epoll : multiplexing many non-blocking descriptors into a
+//         single generator of ready buffers (Linux).
+//
+//      gcomb::epoll_reader r;
+//      for (auto fd : inputs)
+//          r.add (fd);
+//
+//      auto blocks = r.as_generator ();   // fd_block, then bot
+//
+// note:
+//      Each value names the descriptor it was read from along with a
+//      view of the bytes read (valid until the next call). A block with
+//      empty data reports that the descriptor reached end of file (or
+//      failed, see fd_block::error) and has been removed from the set.
+//      The generator reverts to bot once no descriptors remain.
+//
+//      Descriptors are registered level-triggered and at most one block
+//      is read from each per wake-up, so a single busy input cannot
+//      starve the others. A single epoll_wait call reports up to
+//      max_events ready descriptors, amortising the system call over
+//      all of them.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_EPOLL_HPP
+#define GCOMB_EPOLL_HPP
+
+#include <cerrno>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+    struct fd_block
+    {
+        int fd;
+        int error;          // errno of a failed read, otherwise zero
+        view<char> data;    // empty once fd is exhausted
+    };
+
+namespace detail
+{
+    struct epoll_state
+    {
+        epoll_state (std::size_t block_size, int max_events)
+            : ep (::epoll_create1 (EPOLL_CLOEXEC)),
+              buf (block_size ? block_size : 1),
+              events (static_cast<std::size_t> (max_events > 0 ? max_events : 1)),
+              next (0), ready (0)
+        {
+            if (ep.fd < 0)
+                throw_errno ("epoll_create1");
+        }
+
+        ~epoll_state (void) noexcept
+        {
+            for (auto const& f : fds)
+                if (f.second)
+                    ::close (f.first);
+        }
+
+        void remove (int fd) noexcept
+        {
+            ::epoll_ctl (ep.fd, EPOLL_CTL_DEL, fd, nullptr);
+
+            auto const it = fds.find (fd);
+            if (it != fds.end ()) {
+                if (it->second)
+                    ::close (fd);
+                fds.erase (it);
+            }
+
+            // forget any pending readiness reported for it
+            for (auto i = next; i < ready; ++i)
+                if (events[i].data.fd == fd)
+                    events[i].data.fd = -1;
+        }
+
+        fd_handle ep;
+        std::vector<char> buf;
+        std::vector<epoll_event> events;
+        std::size_t next;
+        std::size_t ready;
+
+        // registered descriptors and whether the reader owns them
+        std::unordered_map<int, bool> fds;
+    };
+} // namespace detail
+
+    class epoll_reader
+    {
+    public:
+        explicit epoll_reader (std::size_t block_size = 64 << 10,
+                               int max_events = 256)
+            : st (std::make_shared<detail::epoll_state> (block_size, max_events))
+        {}
+
+        // watch fd (switching it to non-blocking mode); if owned, it is
+        // closed once exhausted or when the reader goes away.
+        //
+        void add (int fd, bool owned = true)
+        {
+            auto const flags = ::fcntl (fd, F_GETFL);
+            if (flags < 0 || ::fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0)
+                detail::throw_errno ("fcntl");
+
+            epoll_event ev;
+            ev.events  = EPOLLIN | EPOLLRDHUP;
+            ev.data.u64 = 0;
+            ev.data.fd = fd;
+
+            if (::epoll_ctl (st->ep.fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+                detail::throw_errno ("epoll_ctl");
+
+            st->fds[fd] = owned;
+        }
+
+        // stop watching fd without waiting for end of file
+        //
+        void remove (int fd) noexcept
+        {
+            st->remove (fd);
+        }
+
+        std::size_t size (void) const noexcept
+        {
+            return st->fds.size ();
+        }
+
+        algebraic_generator<fd_block, bot_t> as_generator (void) const
+        {
+            using A = algebraic::algebraic<fd_block, bot_t>;
+
+            auto const st = this->st;
+
+            return algebraic_generator<fd_block, bot_t>
+                ([st] (void) -> A
+                {
+                    for (;;) {
+                        while (st->next < st->ready) {
+                            int const fd = st->events[st->next++].data.fd;
+                            if (fd < 0)
+                                continue;
+
+                            auto const n = ::read (fd, st->buf.data (), st->buf.size ());
+                            if (n > 0)
+                                return A (fd_block {fd, 0, make_view
+                                    (st->buf.data (), static_cast<std::size_t> (n))});
+
+                            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                                          errno == EINTR))
+                                continue;
+
+                            int const err = n < 0 ? errno : 0;
+                            st->remove (fd);
+                            return A (fd_block {fd, err, make_view
+                                (static_cast<char const*> (nullptr), 0)});
+                        }
+
+                        if (st->fds.empty ())
+                            return A (bot_t{});
+
+                        int const n = ::epoll_wait
+                            (st->ep.fd, st->events.data (),
+                             static_cast<int> (st->events.size ()), -1);
+
+                        if (n < 0) {
+                            if (errno == EINTR)
+                                continue;
+                            detail::throw_errno ("epoll_wait");
+                        }
+
+                        st->next  = 0;
+                        st->ready = static_cast<std::size_t> (n);
+                    }
+                });
+        }
+
+    private:
+        std::shared_ptr<detail::epoll_state> st;
+    };
+
+
+    // multiplex the given descriptors (taking ownership of them)
+    //
+    inline algebraic_generator<fd_block, bot_t>
+        ready_blocks (std::vector<int> const& fds,
+                      std::size_t block_size = 64 << 10)
+    {
+        epoll_reader r (block_size);
+        for (auto const fd : fds)
+            r.add (fd);
+        return r.as_generator ();
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_EPOLL_HPP
@@ -0,0 +1,379 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// fiber : running a push-style (callback driven) producer on a stack
+//         of its own so that it can be pulled like any other generator.
+//
+//      auto rows = gcomb::from_push<row> ([] (auto yield)
+//      {
+//          csv_parse (file, [&] (row const& r) { yield (r); });
+//      });
+//
+//      auto r = rows ();   // runs the parser until its next callback
+//
+// note:
+//      The producer runs on a fiber: a separately allocated stack that
+//      the consumer switches to on every pull and that yield switches
+//      back from. There are no threads, locks or queues involved; each
+//      value costs two context switches, which on x86-64 are a handful
+//      of register saves (see gcomb_fiber_switch below) and elsewhere
+//      fall back to ucontext (which also saves the signal mask and so
+//      costs a system call). Define GCOMB_FIBER_UCONTEXT to force the
+//      fallback.
+//
+//      A yielded value is only copied once, when the consumer receives
+//      it; yield passes a pointer into the (suspended) producer's frame.
+//
+//      The generator reverts to bot when the producer returns. An
+//      exception escaping the producer is rethrown to the consumer at
+//      the point in the stream where it was raised.
+//
+//      Fiber stacks are reserved lazily (only touched pages are backed
+//      by memory) and sit above a guard page, so an overflow faults
+//      rather than corrupting the heap; size them for the producer's
+//      deepest call chain.
+//
+//      If the generator is destroyed before its producer has finished,
+//      the suspended yield throws detail::fiber_unwind so the producer's
+//      stack is unwound and its destructors run. Producers must let that
+//      exception propagate, and any C frames between yield and the
+//      producer need unwind tables (the default on x86-64 Linux).
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_FIBER_HPP
+#define GCOMB_FIBER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined (__x86_64__) && defined (__ELF__) && !defined (GCOMB_FIBER_UCONTEXT)
+    #define GCOMB_FIBER_ASM 1
+#else
+    #include <ucontext.h>
+#endif
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+
+#ifdef GCOMB_FIBER_ASM
+
+// gcomb_fiber_switch (void ** save, void * load)
+//
+//      Saves the callee-saved registers, MXCSR and the x87 control word
+//      on the current stack, stores the stack pointer to *save and
+//      resumes the context whose stack pointer is load.
+//
+// gcomb_fiber_start
+//
+//      The first frame of every fiber: calls r13 (r12) on the fresh
+//      stack. Its unwind information marks the outermost frame.
+//
+// Both live in a COMDAT group so that the definitions emitted by every
+// translation unit including this header collapse to one.
+//
+asm (R"(
+    .pushsection .text.gcomb_fiber,"axG",@progbits,gcomb_fiber,comdat
+    .weak   gcomb_fiber_switch
+    .hidden gcomb_fiber_switch
+    .type   gcomb_fiber_switch,@function
+    .p2align 4
+gcomb_fiber_switch:
+    .cfi_startproc
+    pushq   %rbp
+    pushq   %rbx
+    pushq   %r12
+    pushq   %r13
+    pushq   %r14
+    pushq   %r15
+    subq    $16, %rsp
+    stmxcsr 8(%rsp)
+    fnstcw  12(%rsp)
+    movq    %rsp, (%rdi)
+    movq    %rsi, %rsp
+    ldmxcsr 8(%rsp)
+    fldcw   12(%rsp)
+    addq    $16, %rsp
+    popq    %r15
+    popq    %r14
+    popq    %r13
+    popq    %r12
+    popq    %rbx
+    popq    %rbp
+    ret
+    .cfi_endproc
+    .size   gcomb_fiber_switch,.-gcomb_fiber_switch
+
+    .weak   gcomb_fiber_start
+    .hidden gcomb_fiber_start
+    .type   gcomb_fiber_start,@function
+    .p2align 4
+gcomb_fiber_start:
+    .cfi_startproc
+    .cfi_undefined rip
+    movq    %r12, %rdi
+    callq   *%r13
+    ud2
+    .cfi_endproc
+    .size   gcomb_fiber_start,.-gcomb_fiber_start
+    .popsection
+)");
+
+extern "C" void gcomb_fiber_switch (void ** save, void * load);
+extern "C" void gcomb_fiber_start (void);
+
+#endif // ifdef GCOMB_FIBER_ASM
+
+namespace gcomb
+{
+namespace detail
+{
+    // a suspended stack and the context that last resumed it
+    //
+    class fiber
+    {
+    public:
+        using entry_fn = void (*) (void *);
+
+        fiber (entry_fn fn, void * arg, std::size_t stack_size)
+            : fn (fn), arg (arg)
+        {
+            auto const page = static_cast<std::size_t> (::sysconf (_SC_PAGESIZE));
+            stack_len = ((stack_size + page - 1) / page + 1) * page;
+
+            void * const p = ::mmap (nullptr, stack_len, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE,
+                                     -1, 0);
+            if (p == MAP_FAILED)
+                throw_errno ("mmap fiber stack");
+            stack = static_cast<char *> (p);
+
+            // the lowest page catches overflows
+            if (::mprotect (stack, page, PROT_NONE) != 0) {
+                ::munmap (stack, stack_len);
+                throw_errno ("mprotect fiber stack");
+            }
+
+#ifdef GCOMB_FIBER_ASM
+            // a frame for gcomb_fiber_switch to "return" into
+            // gcomb_fiber_start from, with rsp 16-byte aligned there
+            auto const top = reinterpret_cast<std::uintptr_t> (stack + stack_len) & ~std::uintptr_t (15);
+            auto const frame = reinterpret_cast<std::uint64_t *> (top - 16);
+
+            frame[-1] = reinterpret_cast<std::uint64_t> (&gcomb_fiber_start);
+            frame[-2] = 0;                                          // rbp
+            frame[-3] = 0;                                          // rbx
+            frame[-4] = reinterpret_cast<std::uint64_t> (arg);      // r12
+            frame[-5] = reinterpret_cast<std::uint64_t> (fn);       // r13
+            frame[-6] = 0;                                          // r14
+            frame[-7] = 0;                                          // r15
+
+            std::uint32_t const control[2] = {0x1f80, 0x037f};      // mxcsr, fpu cw
+            std::memcpy (frame - 8, control, sizeof control);
+
+            fiber_sp  = frame - 9;
+            caller_sp = nullptr;
+#else
+            if (::getcontext (&fiber_ctx) != 0) {
+                ::munmap (stack, stack_len);
+                throw_errno ("getcontext");
+            }
+
+            fiber_ctx.uc_stack.ss_sp   = stack + page;
+            fiber_ctx.uc_stack.ss_size = stack_len - page;
+            fiber_ctx.uc_link          = nullptr;
+
+            // makecontext only passes ints
+            auto const self = reinterpret_cast<std::uintptr_t> (this);
+            ::makecontext (&fiber_ctx, reinterpret_cast<void (*) (void)> (&ucontext_entry), 2,
+                           static_cast<unsigned> (self >> 32),
+                           static_cast<unsigned> (self & 0xffffffffu));
+#endif
+        }
+
+        fiber (fiber const&) = delete;
+        fiber & operator= (fiber const&) = delete;
+
+        ~fiber (void) noexcept
+        {
+            ::munmap (stack, stack_len);
+        }
+
+        // switch from the caller to the fiber
+        //
+        void resume (void) noexcept
+        {
+#ifdef GCOMB_FIBER_ASM
+            gcomb_fiber_switch (&caller_sp, fiber_sp);
+#else
+            ::swapcontext (&caller_ctx, &fiber_ctx);
+#endif
+        }
+
+        // switch from the fiber back to whoever resumed it
+        //
+        void suspend (void) noexcept
+        {
+#ifdef GCOMB_FIBER_ASM
+            gcomb_fiber_switch (&fiber_sp, caller_sp);
+#else
+            ::swapcontext (&fiber_ctx, &caller_ctx);
+#endif
+        }
+
+    private:
+#ifndef GCOMB_FIBER_ASM
+        static void ucontext_entry (unsigned hi, unsigned lo)
+        {
+            auto const self = reinterpret_cast<fiber *>
+                ((static_cast<std::uintptr_t> (hi) << 32) | lo);
+            self->fn (self->arg);
+        }
+
+        ucontext_t fiber_ctx;
+        ucontext_t caller_ctx;
+#else
+        void * fiber_sp;
+        void * caller_sp;
+#endif
+        entry_fn fn;
+        void * arg;
+        char * stack;
+        std::size_t stack_len;
+    };
+
+
+    // thrown from yield to unwind an abandoned producer
+    //
+    struct fiber_unwind {};
+
+
+    template <typename T>
+    struct push_channel
+    {
+        explicit push_channel (fiber::entry_fn fn, std::size_t stack_size)
+            : fib (fn, this, stack_size), current (nullptr),
+              started (false), done (false), cancel (false)
+        {}
+
+        fiber fib;
+        T const* current;
+        bool started;
+        bool done;
+        bool cancel;
+        std::exception_ptr error;
+    };
+} // namespace detail
+
+    // handed to a from_push producer; calling it suspends the producer
+    // until the consumer asks for the next value
+    //
+    template <typename T>
+    class push_yield
+    {
+    public:
+        explicit push_yield (detail::push_channel<T> * ch) noexcept
+            : ch (ch)
+        {}
+
+        void operator() (T const& value) const
+        {
+            ch->current = &value;
+            ch->fib.suspend ();
+            if (ch->cancel)
+                throw detail::fiber_unwind {};
+        }
+
+    private:
+        detail::push_channel<T> * ch;
+    };
+
+namespace detail
+{
+    template <typename T, typename F>
+    struct push_state : push_channel<T>
+    {
+        push_state (F && producer, std::size_t stack_size)
+            : push_channel<T> (&entry, stack_size),
+              producer (std::move (producer))
+        {}
+
+        push_state (push_state const&) = delete;
+        push_state & operator= (push_state const&) = delete;
+
+        ~push_state (void) noexcept
+        {
+            if (this->started && not this->done) {
+                this->cancel = true;
+                this->fib.resume ();
+            }
+        }
+
+        // the fiber's outermost frame; must neither throw nor return
+        //
+        static void entry (void * p) noexcept
+        {
+            auto const st = static_cast<push_state *>
+                (static_cast<push_channel<T> *> (p));
+
+            try {
+                st->producer (push_yield<T> (st));
+            } catch (fiber_unwind const&) {
+            } catch (...) {
+                st->error = std::current_exception ();
+            }
+
+            st->current = nullptr;
+            st->done    = true;
+            st->fib.suspend ();
+            std::abort ();  // a finished fiber is never resumed
+        }
+
+        F producer;
+    };
+} // namespace detail
+
+    // turn a producer that calls yield (value) for every value into a
+    // bounded generator; the producer runs on a fiber with a stack of
+    // stack_size bytes.
+    //
+    template <typename T, typename F>
+    algebraic_generator<T, bot_t> from_push (F producer,
+                                             std::size_t stack_size = 256 << 10)
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        auto const st = std::make_shared<detail::push_state<T, F>>
+            (std::move (producer), stack_size);
+
+        return algebraic_generator<T, bot_t>
+            ([st] (void) -> A
+            {
+                if (not st->done) {
+                    st->started = true;
+                    st->fib.resume ();
+                }
+
+                if (st->done) {
+                    if (st->error)
+                        std::rethrow_exception (std::exchange (st->error, nullptr));
+                    return A (bot_t{});
+                }
+
+                return A (*st->current);
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_FIBER_HPP
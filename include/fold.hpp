@@ -0,0 +1,371 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// fold : reducing a stream to a value (fold) or to the stream of its
+//        running reductions (scan).
+//
+//      auto total = gcomb::fold (bounded, 0.0, std::plus<double> ());
+//      auto sums  = gcomb::scan (g, 0L, std::plus<long> ());
+//
+//      // associative op, many threads
+//      auto big = gcomb::fold_parallel (bounded, 0L, std::plus<long> ());
+//
+//      // running totals of whole batches, vectorised
+//      auto cum = gcomb::prefix_sum (gcomb::varint_batches ("ids.bin"));
+//
+// note:
+//      fold_parallel still pulls the generator on the calling thread
+//      (a generator is not safe to call concurrently), but cuts what it
+//      pulls into chunks that a pool of worker threads reduce while the
+//      next chunk is being produced. The per-chunk results are combined
+//      pairwise, as a tree, in stream order; op must be associative,
+//      but need not be commutative.
+//
+//      prefix_sum computes the inclusive running sum of every batch of a
+//      view stream, carrying the total across batches. For 32 and 64
+//      bit integers and floating point types it uses an SSE2 kernel
+//      (log-step shifts within a register, then one add of the carry);
+//      floating point sums are therefore associated differently than a
+//      sequential loop would and may differ in the last bits.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_FOLD_HPP
+#define GCOMB_FOLD_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "algebraic_generator.hpp"
+#include "channel.hpp"
+#include "generator.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+    // reduce a bounded generator from the left: op (... op (init, x0) ..., xn)
+    //
+    template <typename T, typename U, typename Op>
+    U fold (algebraic_generator<T, bot_t> const& g, U init, Op op)
+    {
+        for (;;) {
+            auto const v = g ();
+            if (is_bot (v))
+                return init;
+            init = op (std::move (init), v.template value<T> ());
+        }
+    }
+
+
+    // the running reductions of an infinite generator
+    //
+    template <typename T, typename U, typename Op>
+    generator<U> scan (generator<T> const& g, U init, Op op)
+    {
+        return generator<U>
+            ([g,init,op] (void) mutable -> U
+            {
+                init = op (std::move (init), g ());
+                return init;
+            });
+    }
+
+
+    // the running reductions of a bounded generator, reverting to bot
+    // with it
+    //
+    template <typename T, typename U, typename Op>
+    algebraic_generator<U, bot_t> scan (algebraic_generator<T, bot_t> const& g,
+                                        U init, Op op)
+    {
+        using A = algebraic::algebraic<U, bot_t>;
+
+        return algebraic_generator<U, bot_t>
+            ([g,init,op] (void) mutable -> A
+            {
+                auto const v = g ();
+                if (is_bot (v))
+                    return A (bot_t{});
+                init = op (std::move (init), v.template value<T> ());
+                return A (init);
+            });
+    }
+
+namespace detail
+{
+    template <typename T>
+    using fold_chunk = std::pair<std::size_t, std::shared_ptr<std::vector<T>>>;
+
+
+    // combine adjacent partial results level by level
+    //
+    template <typename T, typename Op>
+    T tree_combine (std::vector<T> level, Op & op)
+    {
+        while (level.size () > 1) {
+            std::vector<T> next;
+            next.reserve ((level.size () + 1) / 2);
+
+            for (std::size_t i = 0; i + 1 < level.size (); i += 2)
+                next.push_back (op (std::move (level[i]), std::move (level[i + 1])));
+            if (level.size () % 2)
+                next.push_back (std::move (level.back ()));
+
+            level.swap (next);
+        }
+        return std::move (level.front ());
+    }
+} // namespace detail
+
+    // fold a bounded generator with an associative op, reducing chunks
+    // of `chunk` values on `threads` workers (all hardware threads when
+    // zero) and combining them as a tree.
+    //
+    template <typename T, typename Op>
+    T fold_parallel (algebraic_generator<T, bot_t> const& g, T init, Op op,
+                     std::size_t chunk = 1 << 16, unsigned threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max (1u, std::thread::hardware_concurrency ());
+        if (chunk == 0)
+            chunk = 1;
+
+        channel<detail::fold_chunk<T>> work (2 * threads);
+
+        std::mutex m;
+        std::vector<std::pair<std::size_t, T>> partials;
+        std::exception_ptr error;
+
+        auto const fail = [&] (std::exception_ptr e)
+        {
+            std::lock_guard<std::mutex> lock (m);
+            if (not error)
+                error = e;
+            work.close ();
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 0; i < threads; ++i)
+            pool.emplace_back ([&] (void)
+            {
+                try {
+                    detail::fold_chunk<T> c;
+                    while (work.pop (c)) {
+                        auto const& xs = *c.second;
+                        T acc = xs[0];
+                        for (std::size_t j = 1; j < xs.size (); ++j)
+                            acc = op (std::move (acc), xs[j]);
+
+                        std::lock_guard<std::mutex> lock (m);
+                        partials.emplace_back (c.first, std::move (acc));
+                    }
+                } catch (...) {
+                    fail (std::current_exception ());
+                }
+            });
+
+        try {
+            std::size_t index = 0;
+            auto buf = std::make_shared<std::vector<T>> ();
+            buf->reserve (chunk);
+
+            for (;;) {
+                auto const v = g ();
+                bool const end = is_bot (v);
+
+                if (not end)
+                    buf->push_back (v.template value<T> ());
+
+                if (buf->size () == chunk || (end && not buf->empty ())) {
+                    if (not work.push (detail::fold_chunk<T> (index++, std::move (buf))))
+                        break;
+                    buf = std::make_shared<std::vector<T>> ();
+                    buf->reserve (chunk);
+                }
+
+                if (end)
+                    break;
+            }
+        } catch (...) {
+            fail (std::current_exception ());
+        }
+
+        work.close ();
+        for (auto & t : pool)
+            t.join ();
+
+        if (error)
+            std::rethrow_exception (error);
+        if (partials.empty ())
+            return init;
+
+        std::sort (partials.begin (), partials.end (),
+            [] (std::pair<std::size_t, T> const& a, std::pair<std::size_t, T> const& b)
+            {
+                return a.first < b.first;
+            });
+
+        std::vector<T> level;
+        level.reserve (partials.size ());
+        for (auto & p : partials)
+            level.push_back (std::move (p.second));
+
+        return op (std::move (init), detail::tree_combine (std::move (level), op));
+    }
+
+namespace detail
+{
+    // out[i] = carry + in[0] + ... + in[i]; returns the new carry
+    //
+    template <typename T>
+    T prefix_sum_scalar (T const* in, T * out, std::size_t n, T carry) noexcept
+    {
+        for (std::size_t i = 0; i < n; ++i) {
+            carry += in[i];
+            out[i] = carry;
+        }
+        return carry;
+    }
+
+    template <typename T>
+    T prefix_sum (T const* in, T * out, std::size_t n, T carry) noexcept
+    {
+        return prefix_sum_scalar (in, out, n, carry);
+    }
+
+#if defined(__SSE2__)
+    inline std::uint32_t prefix_sum (std::uint32_t const* in, std::uint32_t * out,
+                                     std::size_t n, std::uint32_t carry) noexcept
+    {
+        auto c = _mm_set1_epi32 (static_cast<int> (carry));
+        std::size_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+            auto x = _mm_loadu_si128 (reinterpret_cast<__m128i const*> (in + i));
+            x = _mm_add_epi32 (x, _mm_slli_si128 (x, 4));
+            x = _mm_add_epi32 (x, _mm_slli_si128 (x, 8));
+            x = _mm_add_epi32 (x, c);
+            _mm_storeu_si128 (reinterpret_cast<__m128i *> (out + i), x);
+            c = _mm_shuffle_epi32 (x, _MM_SHUFFLE (3, 3, 3, 3));
+        }
+
+        carry = static_cast<std::uint32_t> (_mm_cvtsi128_si32 (c));
+        return prefix_sum_scalar (in + i, out + i, n - i, carry);
+    }
+
+    inline std::int32_t prefix_sum (std::int32_t const* in, std::int32_t * out,
+                                    std::size_t n, std::int32_t carry) noexcept
+    {
+        // two's complement addition is the same operation
+        return static_cast<std::int32_t> (prefix_sum
+            (reinterpret_cast<std::uint32_t const*> (in),
+             reinterpret_cast<std::uint32_t *> (out), n,
+             static_cast<std::uint32_t> (carry)));
+    }
+
+    inline std::uint64_t prefix_sum (std::uint64_t const* in, std::uint64_t * out,
+                                     std::size_t n, std::uint64_t carry) noexcept
+    {
+        auto c = _mm_set1_epi64x (static_cast<long long> (carry));
+        std::size_t i = 0;
+
+        for (; i + 2 <= n; i += 2) {
+            auto x = _mm_loadu_si128 (reinterpret_cast<__m128i const*> (in + i));
+            x = _mm_add_epi64 (x, _mm_slli_si128 (x, 8));
+            x = _mm_add_epi64 (x, c);
+            _mm_storeu_si128 (reinterpret_cast<__m128i *> (out + i), x);
+            c = _mm_unpackhi_epi64 (x, x);
+        }
+
+        carry = static_cast<std::uint64_t> (_mm_cvtsi128_si64 (c));
+        return prefix_sum_scalar (in + i, out + i, n - i, carry);
+    }
+
+    inline std::int64_t prefix_sum (std::int64_t const* in, std::int64_t * out,
+                                    std::size_t n, std::int64_t carry) noexcept
+    {
+        return static_cast<std::int64_t> (prefix_sum
+            (reinterpret_cast<std::uint64_t const*> (in),
+             reinterpret_cast<std::uint64_t *> (out), n,
+             static_cast<std::uint64_t> (carry)));
+    }
+
+    inline float prefix_sum (float const* in, float * out,
+                             std::size_t n, float carry) noexcept
+    {
+        auto c = _mm_set1_ps (carry);
+        std::size_t i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+            auto x = _mm_loadu_ps (in + i);
+            x = _mm_add_ps (x, _mm_castsi128_ps (_mm_slli_si128 (_mm_castps_si128 (x), 4)));
+            x = _mm_add_ps (x, _mm_castsi128_ps (_mm_slli_si128 (_mm_castps_si128 (x), 8)));
+            x = _mm_add_ps (x, c);
+            _mm_storeu_ps (out + i, x);
+            c = _mm_shuffle_ps (x, x, _MM_SHUFFLE (3, 3, 3, 3));
+        }
+
+        return prefix_sum_scalar (in + i, out + i, n - i, _mm_cvtss_f32 (c));
+    }
+
+    inline double prefix_sum (double const* in, double * out,
+                              std::size_t n, double carry) noexcept
+    {
+        auto c = _mm_set1_pd (carry);
+        std::size_t i = 0;
+
+        for (; i + 2 <= n; i += 2) {
+            auto x = _mm_loadu_pd (in + i);
+            x = _mm_add_pd (x, _mm_castsi128_pd (_mm_slli_si128 (_mm_castpd_si128 (x), 8)));
+            x = _mm_add_pd (x, c);
+            _mm_storeu_pd (out + i, x);
+            c = _mm_unpackhi_pd (x, x);
+        }
+
+        return prefix_sum_scalar (in + i, out + i, n - i, _mm_cvtsd_f64 (c));
+    }
+#endif
+} // namespace detail
+
+    // the inclusive running sum over a stream of batches, one output
+    // batch (valid until the next call) per input batch.
+    //
+    template <typename T>
+    algebraic_generator<view<T>, bot_t>
+        prefix_sum (algebraic_generator<view<T>, bot_t> const& batches, T init = T ())
+    {
+        using A = algebraic::algebraic<view<T>, bot_t>;
+
+        std::vector<T> buf;
+
+        return algebraic_generator<view<T>, bot_t>
+            ([batches,buf,init] (void) mutable -> A
+            {
+                auto const v = batches ();
+                if (is_bot (v))
+                    return A (bot_t{});
+
+                auto const in = v.template value<view<T>> ();
+                if (buf.size () < in.size ())
+                    buf.resize (in.size ());
+
+                init = detail::prefix_sum (in.data (), buf.data (), in.size (), init);
+                return A (make_view (static_cast<T const*> (buf.data ()), in.size ()));
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_FOLD_HPP
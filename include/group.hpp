@@ -0,0 +1,318 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// group : collapsing runs of equal keys in sorted streams.
+//
+//      // (user id, events of that user)
+//      auto users = gcomb::group_by (sorted_events,
+//                                    [] (event const& e) { return e.user; });
+//
+//      // (value, how many times in a row)
+//      auto counts = gcomb::run_length (sorted_ids);
+//
+// note:
+//      Both work on adjacent values only: on a sorted (or otherwise
+//      clustered) stream a key's values form one group, elsewhere the
+//      same key may come out several times.
+//
+//      group_by yields (key, view of the group's values). The view is
+//      valid until the next call; groups are gathered into one buffer
+//      reused for every group, so nothing is allocated per group once
+//      the buffer has grown to the largest group.
+//
+//      Both also accept a stream of batches (views, e.g. from chunk,
+//      records or varint_batches) and then scan each batch directly.
+//      A group that lies within one batch is handed out as a view into
+//      that batch without being copied; only groups straddling batches
+//      are gathered into the buffer.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_GROUP_HPP
+#define GCOMB_GROUP_HPP
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    template <typename T, typename K>
+    struct group_state
+    {
+        std::vector<T> buf;
+        K key;
+        T next;             // first value of the following group
+        bool has_next;
+        bool done;
+    };
+
+
+    template <typename T, typename K>
+    struct group_batch_state
+    {
+        view<T> batch;
+        std::size_t pos;
+        std::vector<T> carry;   // a group continued from earlier batches
+        K key;
+        bool done;
+    };
+
+
+    template <typename T>
+    struct run_batch_state
+    {
+        view<T> batch;
+        std::size_t pos;
+        T value;                // a run continued from earlier batches
+        std::size_t count;
+        bool done;
+    };
+} // namespace detail
+
+    // (key, values) for each run of values with equal keys
+    //
+    template <typename T, typename Key,
+        typename K = typename std::decay<typename std::result_of<Key(T const&)>::type>::type>
+    algebraic_generator<std::tuple<K, view<T>>, bot_t>
+        group_by (algebraic_generator<T, bot_t> const& g, Key key)
+    {
+        using R = std::tuple<K, view<T>>;
+        using A = algebraic::algebraic<R, bot_t>;
+
+        detail::group_state<T, K> st {};
+        st.has_next = false;
+        st.done = false;
+
+        return algebraic_generator<R, bot_t>
+            ([g,key,st] (void) mutable -> A
+            {
+                if (not st.has_next) {
+                    if (st.done)
+                        return A (bot_t{});
+
+                    auto const v = g ();
+                    if (is_bot (v)) {
+                        st.done = true;
+                        return A (bot_t{});
+                    }
+                    st.next = v.template value<T> ();
+                }
+
+                st.buf.clear ();
+                st.buf.push_back (std::move (st.next));
+                st.key = key (st.buf.front ());
+                st.has_next = false;
+
+                for (;;) {
+                    auto const v = g ();
+                    if (is_bot (v)) {
+                        st.done = true;
+                        break;
+                    }
+
+                    auto x = v.template value<T> ();
+                    if (not (key (x) == st.key)) {
+                        st.next = std::move (x);
+                        st.has_next = true;
+                        break;
+                    }
+                    st.buf.push_back (std::move (x));
+                }
+
+                return A (R (st.key, make_view (static_cast<T const*> (st.buf.data ()),
+                                                 st.buf.size ())));
+            });
+    }
+
+
+    // group_by over a stream of batches
+    //
+    template <typename T, typename Key,
+        typename K = typename std::decay<typename std::result_of<Key(T const&)>::type>::type>
+    algebraic_generator<std::tuple<K, view<T>>, bot_t>
+        group_by (algebraic_generator<view<T>, bot_t> const& batches, Key key)
+    {
+        using R = std::tuple<K, view<T>>;
+        using A = algebraic::algebraic<R, bot_t>;
+
+        detail::group_batch_state<T, K> st {};
+        st.batch = make_view (static_cast<T const*> (nullptr), 0);
+        st.pos = 0;
+        st.done = false;
+
+        return algebraic_generator<R, bot_t>
+            ([batches,key,st] (void) mutable -> A
+            {
+                st.carry.clear ();
+
+                for (;;) {
+                    auto const& b = st.batch;
+
+                    if (st.pos == b.size ()) {
+                        if (not st.done) {
+                            auto const v = batches ();
+                            if (is_bot (v))
+                                st.done = true;
+                            else {
+                                st.batch = v.template value<view<T>> ();
+                                st.pos = 0;
+                                continue;
+                            }
+                        }
+
+                        if (st.carry.empty ())
+                            return A (bot_t{});
+                        return A (R (st.key, make_view
+                            (static_cast<T const*> (st.carry.data ()), st.carry.size ())));
+                    }
+
+                    auto const first = st.pos;
+                    if (st.carry.empty ())
+                        st.key = key (b[first]);
+
+                    auto last = first;
+                    while (last < b.size () && key (b[last]) == st.key)
+                        ++last;
+                    st.pos = last;
+
+                    if (last < b.size ()) {
+                        // the group ends inside this batch
+                        if (st.carry.empty ())
+                            return A (R (st.key, make_view (b.data () + first, last - first)));
+
+                        st.carry.insert (st.carry.end (), b.data () + first, b.data () + last);
+                        return A (R (st.key, make_view
+                            (static_cast<T const*> (st.carry.data ()), st.carry.size ())));
+                    }
+
+                    // it may continue in the next batch
+                    st.carry.insert (st.carry.end (), b.data () + first, b.data () + last);
+                }
+            });
+    }
+
+
+    // (value, count) for each run of equal values
+    //
+    template <typename T>
+    algebraic_generator<std::tuple<T, std::size_t>, bot_t>
+        run_length (algebraic_generator<T, bot_t> const& g)
+    {
+        using R = std::tuple<T, std::size_t>;
+        using A = algebraic::algebraic<R, bot_t>;
+
+        detail::group_state<T, bool> st {};
+        st.has_next = false;
+        st.done = false;
+
+        return algebraic_generator<R, bot_t>
+            ([g,st] (void) mutable -> A
+            {
+                if (not st.has_next) {
+                    if (st.done)
+                        return A (bot_t{});
+
+                    auto const v = g ();
+                    if (is_bot (v)) {
+                        st.done = true;
+                        return A (bot_t{});
+                    }
+                    st.next = v.template value<T> ();
+                }
+
+                R out (std::move (st.next), 1);
+                st.has_next = false;
+
+                for (;;) {
+                    auto const v = g ();
+                    if (is_bot (v)) {
+                        st.done = true;
+                        break;
+                    }
+
+                    auto x = v.template value<T> ();
+                    if (not (x == std::get<0> (out))) {
+                        st.next = std::move (x);
+                        st.has_next = true;
+                        break;
+                    }
+                    ++std::get<1> (out);
+                }
+
+                return A (std::move (out));
+            });
+    }
+
+
+    // run_length over a stream of batches
+    //
+    template <typename T>
+    algebraic_generator<std::tuple<T, std::size_t>, bot_t>
+        run_length (algebraic_generator<view<T>, bot_t> const& batches)
+    {
+        using R = std::tuple<T, std::size_t>;
+        using A = algebraic::algebraic<R, bot_t>;
+
+        detail::run_batch_state<T> st {};
+        st.batch = make_view (static_cast<T const*> (nullptr), 0);
+        st.pos = 0;
+        st.count = 0;
+        st.done = false;
+
+        return algebraic_generator<R, bot_t>
+            ([batches,st] (void) mutable -> A
+            {
+                for (;;) {
+                    auto const& b = st.batch;
+
+                    if (st.pos == b.size ()) {
+                        if (not st.done) {
+                            auto const v = batches ();
+                            if (is_bot (v))
+                                st.done = true;
+                            else {
+                                st.batch = v.template value<view<T>> ();
+                                st.pos = 0;
+                                continue;
+                            }
+                        }
+
+                        if (st.count == 0)
+                            return A (bot_t{});
+                        return A (R (st.value, std::exchange (st.count, 0)));
+                    }
+
+                    if (st.count == 0) {
+                        st.value = b[st.pos];
+                        st.count = 1;
+                        ++st.pos;
+                    }
+
+                    auto const first = st.pos;
+                    auto last = first;
+                    while (last < b.size () && b[last] == st.value)
+                        ++last;
+
+                    st.count += last - first;
+                    st.pos = last;
+
+                    if (last < b.size ())
+                        return A (R (st.value, std::exchange (st.count, 0)));
+                }
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_GROUP_HPP
@@ -0,0 +1,424 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// inflate : a block stage decompressing gzip/zlib/deflate
+//           input on the fly (requires zlib; link with -lz).
+//
+//      auto text = gcomb::lines (gcomb::inflate
+//                      (gcomb::read_blocks ("events.log.gz")));
+//
+// note:
+//      With the default format (inflate_format::automatic) the
+//      stage sniffs the first bytes of its input: gzip and zlib
+//      streams are decompressed, anything else is passed through
+//      untouched, so compressed and plain inputs may be fed through
+//      the same pipeline. Concatenated gzip members are decoded in
+//      sequence, as gzip -d does.
+//
+//      When threaded, inflation (and the upstream block reads, which
+//      run on the same worker) overlap with whatever consumes the
+//      decompressed blocks. Up to `depth` blocks are kept in flight.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_INFLATE_HPP
+#define GCOMB_INFLATE_HPP
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+    enum class inflate_format
+    {
+        automatic,  // gzip or zlib if detected, otherwise pass through
+        gzip,
+        zlib,
+        deflate     // raw deflate, no header
+    };
+
+namespace detail
+{
+    inline bool looks_like_gzip (view<char> v) noexcept
+    {
+        return v.count >= 2 &&
+            static_cast<unsigned char> (v[0]) == 0x1f &&
+            static_cast<unsigned char> (v[1]) == 0x8b;
+    }
+
+
+    inline bool looks_like_zlib (view<char> v) noexcept
+    {
+        if (v.count < 2)
+            return false;
+
+        auto const cmf = static_cast<unsigned char> (v[0]);
+        auto const flg = static_cast<unsigned char> (v[1]);
+
+        return (cmf & 0x0f) == 8 && (cmf >> 4) <= 7 &&
+            ((cmf << 8) | flg) % 31 == 0;
+    }
+
+
+    // pulls compressed blocks from upstream and writes
+    // decompressed bytes into caller supplied buffers.
+    //
+    class inflater
+    {
+    public:
+        inflater (block_generator const& up, inflate_format fmt)
+            : upstream (up), format (fmt), zs (), active (false),
+              passthrough (false), started (false), member_done (false),
+              input_done (false)
+        {}
+
+        inflater (inflater const&) = delete;
+        inflater & operator= (inflater const&) = delete;
+
+        ~inflater (void) noexcept
+        {
+            if (active)
+                ::inflateEnd (&zs);
+        }
+
+        // sniff the stream; must be called before fill
+        //
+        void start (void)
+        {
+            started = true;
+
+            if (not pull ())
+                return;
+
+            int bits = 15;
+            switch (format) {
+                case inflate_format::automatic:
+                    if (not looks_like_gzip (pending) &&
+                        not looks_like_zlib (pending))
+                    {
+                        passthrough = true;
+                        return;
+                    }
+                    bits = 15 + 32;
+                    break;
+                case inflate_format::gzip:    bits = 15 + 16; break;
+                case inflate_format::zlib:    bits = 15;      break;
+                case inflate_format::deflate: bits = -15;     break;
+            }
+
+            if (::inflateInit2 (&zs, bits) != Z_OK)
+                throw std::runtime_error ("gcomb: inflateInit2 failed");
+            active = true;
+        }
+
+        bool is_passthrough (void) const noexcept { return passthrough; }
+
+        // the next raw upstream block, consumed as-is in passthrough mode;
+        // returns false at end of input.
+        //
+        bool next_raw (view<char> & out)
+        {
+            if (pending.count == 0 && not pull ())
+                return false;
+
+            out = pending;
+            pending = view<char> {nullptr, 0};
+            return true;
+        }
+
+        // fill dst with up to cap bytes of output, returning the number
+        // written; zero signals the end of the stream.
+        //
+        std::size_t fill (char * dst, std::size_t cap)
+        {
+            if (passthrough) {
+                std::size_t n = 0;
+                while (n < cap) {
+                    if (pending.count == 0 && not pull ())
+                        break;
+
+                    auto const take = std::min (cap - n, pending.count);
+                    std::memcpy (dst + n, pending.first, take);
+                    n += take;
+                    pending.first += take;
+                    pending.count -= take;
+                }
+                return n;
+            }
+
+            if (not active)
+                return 0;
+
+            zs.next_out  = reinterpret_cast<Bytef *> (dst);
+            zs.avail_out = static_cast<uInt> (cap);
+
+            while (zs.avail_out) {
+                if (pending.count == 0 && not pull ()) {
+                    if (not member_done)
+                        throw std::runtime_error
+                            ("gcomb: truncated compressed stream");
+                    break;
+                }
+
+                if (member_done) {
+                    // another gzip member follows the previous one
+                    ::inflateReset (&zs);
+                    member_done = false;
+                }
+
+                zs.next_in  = reinterpret_cast<Bytef *>
+                    (const_cast<char *> (pending.first));
+                zs.avail_in = static_cast<uInt> (pending.count);
+
+                auto const rc = ::inflate (&zs, Z_NO_FLUSH);
+
+                auto const used = pending.count - zs.avail_in;
+                pending.first += used;
+                pending.count -= used;
+
+                if (rc == Z_STREAM_END) {
+                    member_done = true;
+                } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                    throw std::runtime_error
+                        (std::string ("gcomb: inflate failed: ") +
+                         (zs.msg ? zs.msg : "corrupt input"));
+                }
+            }
+
+            return cap - zs.avail_out;
+        }
+
+        bool is_started (void) const noexcept { return started; }
+
+    private:
+        // fetch the next non-empty upstream block into pending
+        //
+        bool pull (void)
+        {
+            while (not input_done) {
+                auto const next = upstream ();
+                if (is_bot (next)) {
+                    input_done = true;
+                    break;
+                }
+
+                pending = next.template value<view<char>> ();
+                if (pending.count)
+                    return true;
+            }
+
+            pending = view<char> {nullptr, 0};
+            return false;
+        }
+
+        block_generator upstream;
+        inflate_format  format;
+        z_stream        zs;
+        view<char>      pending {nullptr, 0};
+
+        bool active;
+        bool passthrough;
+        bool started;
+        bool member_done;
+        bool input_done;
+    };
+
+
+    // a decompression worker thread filling a ring of `depth`
+    // buffers ahead of the consumer.
+    //
+    class inflate_worker
+    {
+    public:
+        inflate_worker (block_generator const& up, inflate_format fmt,
+                        std::size_t block_size, std::size_t depth)
+            : source (up, fmt), buffers (depth), held (-1), stop (false)
+        {
+            for (std::size_t i = 0; i < depth; ++i) {
+                buffers[i].resize (block_size);
+                free_slots.push_back (i);
+            }
+
+            worker = std::thread ([this] (void) { run (); });
+        }
+
+        inflate_worker (inflate_worker const&) = delete;
+        inflate_worker & operator= (inflate_worker const&) = delete;
+
+        ~inflate_worker (void) noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock (mtx);
+                stop = true;
+            }
+            cv.notify_all ();
+            worker.join ();
+        }
+
+        // the next decompressed block; an empty view marks the end
+        //
+        view<char> next (void)
+        {
+            std::unique_lock<std::mutex> lock (mtx);
+
+            if (held >= 0) {
+                free_slots.push_back (static_cast<std::size_t> (held));
+                held = -1;
+                cv.notify_all ();
+            }
+
+            cv.wait (lock, [this] (void) { return not ready.empty (); });
+
+            auto const slot = ready.front ();
+            if (slot.size == 0) {
+                if (error)
+                    std::rethrow_exception (error);
+                return view<char> {nullptr, 0};
+            }
+
+            ready.pop_front ();
+            held = static_cast<long> (slot.index);
+            return make_view (buffers[slot.index].data (), slot.size);
+        }
+
+    private:
+        struct filled
+        {
+            std::size_t index;
+            std::size_t size;
+        };
+
+        void run (void)
+        {
+            try {
+                source.start ();
+
+                for (;;) {
+                    std::size_t index;
+                    {
+                        std::unique_lock<std::mutex> lock (mtx);
+                        cv.wait (lock, [this] (void)
+                            { return stop || not free_slots.empty (); });
+
+                        if (stop)
+                            return;
+
+                        index = free_slots.front ();
+                        free_slots.pop_front ();
+                    }
+
+                    auto & buf = buffers[index];
+                    auto const n = source.fill (buf.data (), buf.size ());
+
+                    {
+                        std::lock_guard<std::mutex> lock (mtx);
+                        ready.push_back (filled {index, n});
+                    }
+                    cv.notify_all ();
+
+                    if (n == 0)
+                        return;
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock (mtx);
+                error = std::current_exception ();
+                ready.push_back (filled {0, 0});
+            }
+            cv.notify_all ();
+        }
+
+        inflater source;
+        std::vector<std::vector<char>> buffers;
+        std::deque<std::size_t> free_slots;
+        std::deque<filled> ready;
+        long held;
+
+        bool stop;
+        std::exception_ptr error;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::thread worker;
+    };
+} // namespace detail
+
+    // decompress a stream of blocks, producing blocks of (at most)
+    // block_size decompressed bytes.
+    //
+    // If threaded is true, decompression runs on a dedicated thread
+    // which keeps up to depth blocks ready ahead of the consumer.
+    //
+    inline block_generator inflate (block_generator const& blocks,
+                                    std::size_t block_size = 1 << 20,
+                                    bool threaded = false,
+                                    inflate_format format = inflate_format::automatic,
+                                    std::size_t depth = 4)
+    {
+        using A = algebraic::algebraic<view<char>, bot_t>;
+
+        if (threaded) {
+            auto const st = std::make_shared<detail::inflate_worker>
+                (blocks, format, block_size, depth < 2 ? 2 : depth);
+
+            return block_generator
+                ([st] (void) -> A
+                {
+                    auto const v = st->next ();
+                    return v.count ? A (v) : A (bot_t{});
+                });
+        }
+
+        struct state
+        {
+            detail::inflater source;
+            std::vector<char> buf;
+        };
+
+        auto const st = std::shared_ptr<state>
+            (new state {{blocks, format}, std::vector<char> (block_size)});
+
+        return block_generator
+            ([st] (void) -> A
+            {
+                if (not st->source.is_started ())
+                    st->source.start ();
+
+                if (st->source.is_passthrough ()) {
+                    view<char> v;
+                    return st->source.next_raw (v) ? A (v) : A (bot_t{});
+                }
+
+                auto const n = st->source.fill (st->buf.data (), st->buf.size ());
+                return n ? A (make_view (st->buf.data (), n)) : A (bot_t{});
+            });
+    }
+
+
+    // decompress the contents of a file
+    //
+    inline block_generator inflate_file (std::string const& path,
+                                         std::size_t block_size = 1 << 20,
+                                         bool threaded = false)
+    {
+        return inflate (read_blocks (path, block_size), block_size, threaded);
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_INFLATE_HPP
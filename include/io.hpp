@@ -0,0 +1,405 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// io : bounded generators over files and file descriptors.
+//
+//      read_blocks  : large blocks of raw bytes from a file
+//      lines        : delimited records (lines) cut from a block stream
+//      records      : fixed width records cut from a block stream
+//      mapped_file  : a read-only memory mapping of a whole file
+//
+// note:
+//      Every generator here is an algebraic_generator<view<...>, bot_t>,
+//      producing bot once the input is exhausted. The views refer to
+//      buffers owned by the generator and are only valid until its
+//      next call (see view.hpp).
+//
+//      Copies of these generators share the same underlying stream.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_IO_HPP
+#define GCOMB_IO_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    // owning file descriptor
+    //
+    struct fd_handle
+    {
+        int fd;
+
+        explicit fd_handle (int f = -1) noexcept : fd (f) {}
+
+        fd_handle (fd_handle const&) = delete;
+        fd_handle & operator= (fd_handle const&) = delete;
+
+        fd_handle (fd_handle && other) noexcept : fd (other.fd)
+        {
+            other.fd = -1;
+        }
+
+        fd_handle & operator= (fd_handle && other) noexcept
+        {
+            if (this != &other) {
+                if (fd >= 0)
+                    ::close (fd);
+                fd = other.fd;
+                other.fd = -1;
+            }
+            return *this;
+        }
+
+        ~fd_handle (void) noexcept
+        {
+            if (fd >= 0)
+                ::close (fd);
+        }
+    };
+
+
+    [[noreturn]] inline void throw_errno (std::string const& what)
+    {
+        throw std::system_error (errno, std::generic_category (),
+                                 "gcomb: " + what);
+    }
+
+
+    inline int open_or_throw (std::string const& path, int flags,
+                              mode_t mode = 0644)
+    {
+        int const fd = ::open (path.c_str (), flags | O_CLOEXEC, mode);
+        if (fd < 0)
+            throw_errno ("open " + path);
+        return fd;
+    }
+
+
+    // read until the buffer is full or end of file is reached;
+    // returns the number of bytes read.
+    //
+    inline std::size_t read_full (int fd, char * buf, std::size_t n)
+    {
+        std::size_t done = 0;
+        while (done < n) {
+            auto const r = ::read (fd, buf + done, n - done);
+            if (r > 0)
+                done += static_cast<std::size_t> (r);
+            else if (r == 0)
+                break;
+            else if (errno != EINTR)
+                throw_errno ("read");
+        }
+        return done;
+    }
+
+
+    inline void write_full (int fd, char const* buf, std::size_t n)
+    {
+        while (n) {
+            auto const w = ::write (fd, buf, n);
+            if (w >= 0) {
+                buf += w;
+                n   -= static_cast<std::size_t> (w);
+            } else if (errno != EINTR) {
+                throw_errno ("write");
+            }
+        }
+    }
+
+
+    struct block_reader
+    {
+        std::shared_ptr<fd_handle> owner;
+        int fd;
+        std::vector<char> buf;
+        bool done;
+
+        block_reader (int f, std::size_t block_size,
+                      std::shared_ptr<fd_handle> o = nullptr)
+            : owner (std::move (o)), fd (f), buf (block_size), done (false)
+        {
+        #ifdef POSIX_FADV_SEQUENTIAL
+            ::posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        #endif
+        }
+    };
+} // namespace detail
+
+
+    // a read-only mapping of an entire file; pages are only read
+    // from disk once they are touched.
+    //
+    class mapped_file
+    {
+    public:
+        explicit mapped_file (std::string const& path)
+            : fd (detail::open_or_throw (path, O_RDONLY)),
+              base (nullptr), length (0)
+        {
+            struct stat sb;
+            if (::fstat (fd.fd, &sb) != 0)
+                detail::throw_errno ("stat " + path);
+
+            length = static_cast<std::size_t> (sb.st_size);
+            if (length == 0)
+                return;
+
+            auto const addr =
+                ::mmap (nullptr, length, PROT_READ, MAP_PRIVATE, fd.fd, 0);
+            if (addr == MAP_FAILED)
+                detail::throw_errno ("mmap " + path);
+
+            base = static_cast<char const*> (addr);
+        }
+
+        mapped_file (mapped_file const&) = delete;
+        mapped_file & operator= (mapped_file const&) = delete;
+
+        ~mapped_file (void) noexcept
+        {
+            if (base)
+                ::munmap (const_cast<char *> (base), length);
+        }
+
+        char const* data (void) const noexcept { return base; }
+        std::size_t size (void) const noexcept { return length; }
+
+        // hint the kernel about how a byte range will be accessed
+        // (e.g. MADV_SEQUENTIAL, MADV_WILLNEED); purely advisory.
+        //
+        void advise (std::size_t offset, std::size_t n, int advice) const noexcept
+        {
+            if (not base || offset >= length)
+                return;
+
+            auto const page  = static_cast<std::size_t> (::sysconf (_SC_PAGESIZE));
+            auto const first = offset / page * page;
+            auto const last  = std::min (offset + n, length);
+
+            ::madvise (const_cast<char *> (base) + first, last - first, advice);
+        }
+
+    private:
+        detail::fd_handle fd;
+        char const* base;
+        std::size_t length;
+    };
+
+    using block_generator = algebraic_generator<view<char>, bot_t>;
+
+namespace detail
+{
+    inline block_generator read_blocks (std::shared_ptr<block_reader> st)
+    {
+        using A = algebraic::algebraic<view<char>, bot_t>;
+
+        return block_generator
+            ([st] (void) -> A
+            {
+                if (st->done)
+                    return A (bot_t{});
+
+                auto const n = read_full (st->fd, st->buf.data (), st->buf.size ());
+                if (n < st->buf.size ())
+                    st->done = true;
+
+                if (n == 0)
+                    return A (bot_t{});
+
+                return A (make_view (st->buf.data (), n));
+            });
+    }
+} // namespace detail
+
+
+    // produce the contents of fd in blocks of (at most) block_size
+    // bytes; the descriptor is not closed by the generator.
+    //
+    inline block_generator read_blocks (int fd, std::size_t block_size = 1 << 20)
+    {
+        return detail::read_blocks
+            (std::make_shared<detail::block_reader> (fd, block_size));
+    }
+
+
+    inline block_generator read_blocks (std::string const& path,
+                                        std::size_t block_size = 1 << 20)
+    {
+        auto const fh = std::make_shared<detail::fd_handle>
+            (detail::open_or_throw (path, O_RDONLY));
+
+        return detail::read_blocks
+            (std::make_shared<detail::block_reader> (fh->fd, block_size, fh));
+    }
+
+
+    // split a stream of blocks into records terminated by delim
+    // (the delimiter itself is dropped). A final record lacking
+    // a delimiter is still produced.
+    //
+    // note:
+    //      Records lying wholly within a block are handed out as views
+    //      into that block; only records straddling a block boundary
+    //      are copied (into a buffer reused across calls).
+    //
+    inline block_generator lines (block_generator const& blocks,
+                                  char delim = '\n')
+    {
+        using A = algebraic::algebraic<view<char>, bot_t>;
+
+        struct state
+        {
+            block_generator blocks;
+            view<char> cur;
+            std::size_t pos;
+            std::string carry;
+            bool carried;
+            bool done;
+        };
+
+        auto const st = std::make_shared<state>
+            (state {blocks, view<char> {nullptr, 0}, 0, {}, false, false});
+
+        return block_generator
+            ([st,delim] (void) -> A
+            {
+                if (st->carried) {
+                    st->carry.clear ();
+                    st->carried = false;
+                }
+
+                for (;;) {
+                    if (st->pos < st->cur.count) {
+                        auto const first = st->cur.first + st->pos;
+                        auto const rest  = st->cur.count - st->pos;
+                        auto const hit   = static_cast<char const*>
+                            (std::memchr (first, delim, rest));
+
+                        if (hit) {
+                            auto const len =
+                                static_cast<std::size_t> (hit - first);
+                            st->pos += len + 1;
+
+                            if (st->carry.empty ())
+                                return A (make_view (first, len));
+
+                            st->carry.append (first, len);
+                            st->carried = true;
+                            return A (make_view
+                                (st->carry.data (), st->carry.size ()));
+                        }
+
+                        st->carry.append (first, rest);
+                        st->pos = st->cur.count;
+                    }
+
+                    if (st->done)
+                        return A (bot_t{});
+
+                    auto const next = st->blocks ();
+                    if (is_bot (next)) {
+                        st->done = true;
+                        if (st->carry.empty ())
+                            return A (bot_t{});
+
+                        st->carried = true;
+                        return A (make_view
+                            (st->carry.data (), st->carry.size ()));
+                    }
+
+                    st->cur = next.template value<view<char>> ();
+                    st->pos = 0;
+                }
+            });
+    }
+
+
+    // split a stream of blocks into fixed width records of
+    // record_size bytes. A trailing partial record is an error.
+    //
+    inline block_generator records (block_generator const& blocks,
+                                    std::size_t record_size)
+    {
+        using A = algebraic::algebraic<view<char>, bot_t>;
+
+        if (record_size == 0)
+            throw std::invalid_argument ("gcomb: records of size zero");
+
+        struct state
+        {
+            block_generator blocks;
+            view<char> cur;
+            std::size_t pos;
+            std::vector<char> carry;
+            std::size_t have;
+        };
+
+        auto const st = std::make_shared<state>
+            (state {blocks, view<char> {nullptr, 0}, 0,
+                    std::vector<char> (record_size), 0});
+
+        return block_generator
+            ([st,record_size] (void) -> A
+            {
+                for (;;) {
+                    auto const rest = st->cur.count - st->pos;
+
+                    if (st->have == 0 && rest >= record_size) {
+                        auto const first = st->cur.first + st->pos;
+                        st->pos += record_size;
+                        return A (make_view (first, record_size));
+                    }
+
+                    if (rest) {
+                        auto const take = std::min (rest, record_size - st->have);
+                        std::memcpy (st->carry.data () + st->have,
+                                     st->cur.first + st->pos, take);
+                        st->pos  += take;
+                        st->have += take;
+
+                        if (st->have == record_size) {
+                            st->have = 0;
+                            return A (make_view (st->carry.data (), record_size));
+                        }
+                    }
+
+                    auto const next = st->blocks ();
+                    if (is_bot (next)) {
+                        if (st->have)
+                            throw std::runtime_error
+                                ("gcomb: truncated record at end of input");
+                        return A (bot_t{});
+                    }
+
+                    st->cur = next.template value<view<char>> ();
+                    st->pos = 0;
+                }
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_IO_HPP
@@ -0,0 +1,401 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// join : inner equi-joins of two streams.
+//
+//      auto by_user = [] (auto const& r) { return r.user; };
+//
+//      // (user, order) for every order of a known user
+//      auto pairs = gcomb::hash_join (users, orders, by_user);
+//      auto lines = gcomb::bind ([] (user const& u, order const& o)
+//                                { return format (u, o); }, pairs);
+//
+//      // both sides sorted by user
+//      auto pairs = gcomb::merge_join (sorted_users, sorted_orders, by_user);
+//
+// note:
+//      Both yield one (left, right) tuple per matching pair, so a key
+//      that occurs m times on one side and n times on the other gives
+//      m * n tuples; values without a match on the other side are
+//      dropped. The key function is applied to values of both sides.
+//
+//      hash_join drains the (bounded) build side into a table on the
+//      first call and then streams the probe side, which may be bounded
+//      or infinite. Tuples come out in probe order, and for each probe
+//      value in build order. The table is open addressing with linear
+//      probing over 8-byte slots (a 32-bit hash tag and an index) kept
+//      at most half full; build values sit in one contiguous array, and
+//      values sharing a key are chained through a parallel array of
+//      32-bit indices. That is the value plus 4 bytes for each build
+//      value and the key plus 24 to 40 bytes for each distinct key (2
+//      to 4 slots, as the table doubles, and the first/last indices),
+//      with no allocation per value. At most 2^32 - 1 build values.
+//      Copies of a hash_join share the table, built once, but each
+//      advances its own copy of the probe side.
+//
+//      merge_join needs both sides sorted by key under cmp (std::less
+//      by default), as sort_external produces them. It holds only the
+//      right side's values for the current key, in a reused buffer, and
+//      stops as soon as either side runs out.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_JOIN_HPP
+#define GCOMB_JOIN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    // build side of a hash join: values grouped by key
+    //
+    template <typename K, typename B, typename Hash>
+    class join_table
+    {
+    public:
+        static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max ();
+
+        explicit join_table (Hash hash)
+            : slots (16), hash (hash)
+        {}
+
+        void insert (K key, B value)
+        {
+            if (rows.size () == npos)
+                throw std::length_error ("gcomb: hash_join build side exceeds 2^32 - 1 values");
+
+            auto const r = static_cast<std::uint32_t> (rows.size ());
+            rows.push_back (std::move (value));
+            links.push_back (npos);
+
+            auto const h = mix (key);
+            auto const e = lookup (key, h);
+            if (e != npos) {
+                links[last[e]] = r;
+                last[e] = r;
+                return;
+            }
+
+            if (2 * (keys.size () + 1) > slots.size ())
+                grow ();
+
+            auto const k = static_cast<std::uint32_t> (keys.size ());
+            keys.push_back (std::move (key));
+            first.push_back (r);
+            last.push_back (r);
+            place (h, k);
+        }
+
+        // the first value with key, or npos
+        //
+        std::uint32_t find (K const& key) const
+        {
+            auto const e = lookup (key, mix (key));
+            return e == npos ? npos : first[e];
+        }
+
+        // the next value with the same key, or npos
+        //
+        std::uint32_t next (std::uint32_t r) const noexcept
+        {
+            return links[r];
+        }
+
+        B const& value (std::uint32_t r) const noexcept
+        {
+            return rows[r];
+        }
+
+        bool empty (void) const noexcept
+        {
+            return rows.empty ();
+        }
+
+    private:
+        struct slot
+        {
+            std::uint32_t tag;
+            std::uint32_t entry;    // key index + 1; 0 when free
+        };
+
+        std::uint64_t mix (K const& key) const
+        {
+            // std::hash is often the identity; spread it over all bits
+            return static_cast<std::uint64_t> (hash (key)) * 0x9e3779b97f4a7c15ull;
+        }
+
+        std::uint32_t lookup (K const& key, std::uint64_t h) const
+        {
+            auto const mask = slots.size () - 1;
+            auto const tag  = static_cast<std::uint32_t> (h);
+
+            for (auto i = static_cast<std::size_t> (h >> 32) & mask;; i = (i + 1) & mask) {
+                auto const& s = slots[i];
+                if (s.entry == 0)
+                    return npos;
+                if (s.tag == tag && keys[s.entry - 1] == key)
+                    return s.entry - 1;
+            }
+        }
+
+        void place (std::uint64_t h, std::uint32_t k) noexcept
+        {
+            auto const mask = slots.size () - 1;
+            auto i = static_cast<std::size_t> (h >> 32) & mask;
+            while (slots[i].entry != 0)
+                i = (i + 1) & mask;
+            slots[i] = slot {static_cast<std::uint32_t> (h), k + 1};
+        }
+
+        void grow (void)
+        {
+            std::vector<slot> (2 * slots.size ()).swap (slots);
+            for (std::size_t k = 0; k < keys.size (); ++k)
+                place (mix (keys[k]), static_cast<std::uint32_t> (k));
+        }
+
+        std::vector<slot> slots;
+        std::vector<K> keys;
+        std::vector<std::uint32_t> first;   // per key
+        std::vector<std::uint32_t> last;
+        std::vector<B> rows;
+        std::vector<std::uint32_t> links;   // per value
+        Hash hash;
+    };
+
+    template <typename K, typename B, typename Hash>
+    constexpr std::uint32_t join_table<K, B, Hash>::npos;
+
+
+    // the build side of a hash join, drained into its table on first
+    // use; shared by copies of the join, which only read it afterwards
+    //
+    template <typename K, typename B, typename Hash>
+    struct hash_join_build
+    {
+        hash_join_build (algebraic_generator<B, bot_t> const& g, Hash hash)
+            : source (g), table (hash), built (false)
+        {}
+
+        template <typename Key>
+        join_table<K, B, Hash> const& get (Key & key)
+        {
+            if (not built) {
+                built = true;
+                for (;;) {
+                    auto const v = source ();
+                    if (is_bot (v))
+                        break;
+
+                    auto const& b = v.template value<B> ();
+                    table.insert (key (b), b);
+                }
+            }
+            return table;
+        }
+
+        algebraic_generator<B, bot_t> source;
+        join_table<K, B, Hash> table;
+        bool built;
+    };
+
+
+    template <typename K, typename L, typename R>
+    struct merge_join_state
+    {
+        merge_join_state (void)
+            : left (), right (), group_key (), idx (0),
+              has_group (false), right_live (false), started (false), done (false)
+        {}
+
+        void pull (algebraic_generator<R, bot_t> const& g)
+        {
+            auto const v = g ();
+            right_live = not is_bot (v);
+            if (right_live)
+                right = v.template value<R> ();
+        }
+
+        L left;
+        R right;                // head of the right side
+        std::vector<R> group;   // right values with key group_key
+        K group_key;
+        std::size_t idx;        // next of group to pair with left
+        bool has_group;
+        bool right_live;
+        bool started;
+        bool done;
+    };
+} // namespace detail
+
+    // (build value, probe value) for every pair with equal keys; the
+    // probe side is bounded.
+    //
+    template <typename B, typename P, typename Key,
+        typename K = typename std::decay<typename std::result_of<Key(B const&)>::type>::type,
+        typename Hash = std::hash<K>>
+    algebraic_generator<std::tuple<B, P>, bot_t>
+        hash_join (algebraic_generator<B, bot_t> const& build,
+                   algebraic_generator<P, bot_t> const& probe,
+                   Key key, Hash hash = Hash ())
+    {
+        using R = std::tuple<B, P>;
+        using A = algebraic::algebraic<R, bot_t>;
+        using table_type = detail::join_table<K, B, Hash>;
+
+        auto const side = std::make_shared<detail::hash_join_build<K, B, Hash>> (build, hash);
+        P current {};
+        auto cursor = table_type::npos;     // next match for current
+
+        return algebraic_generator<R, bot_t>
+            ([probe,key,side,current,cursor] (void) mutable -> A
+            {
+                auto const& table = side->get (key);
+
+                while (cursor == table_type::npos) {
+                    if (table.empty ())
+                        return A (bot_t{});
+
+                    auto const v = probe ();
+                    if (is_bot (v))
+                        return A (bot_t{});
+
+                    current = v.template value<P> ();
+                    cursor  = table.find (key (current));
+                }
+
+                auto const r = cursor;
+                cursor = table.next (r);
+                return A (R (table.value (r), current));
+            });
+    }
+
+
+    // hash_join with an infinite probe side; the build side must not be
+    // empty.
+    //
+    template <typename B, typename P, typename Key,
+        typename K = typename std::decay<typename std::result_of<Key(B const&)>::type>::type,
+        typename Hash = std::hash<K>>
+    generator<std::tuple<B, P>>
+        hash_join (algebraic_generator<B, bot_t> const& build,
+                   generator<P> const& probe,
+                   Key key, Hash hash = Hash ())
+    {
+        using R = std::tuple<B, P>;
+        using table_type = detail::join_table<K, B, Hash>;
+
+        auto const side = std::make_shared<detail::hash_join_build<K, B, Hash>> (build, hash);
+        P current {};
+        auto cursor = table_type::npos;
+
+        return generator<R>
+            ([probe,key,side,current,cursor] (void) mutable -> R
+            {
+                auto const& table = side->get (key);
+                if (table.empty ())
+                    throw std::runtime_error
+                        ("gcomb: hash_join of an infinite stream with an empty build side");
+
+                while (cursor == table_type::npos) {
+                    current = probe ();
+                    cursor  = table.find (key (current));
+                }
+
+                auto const r = cursor;
+                cursor = table.next (r);
+                return R (table.value (r), current);
+            });
+    }
+
+
+    // (left value, right value) for every pair with equal keys of two
+    // bounded generators sorted by key.
+    //
+    template <typename L, typename R, typename Key,
+        typename K = typename std::decay<typename std::result_of<Key(L const&)>::type>::type,
+        typename Compare = std::less<K>>
+    algebraic_generator<std::tuple<L, R>, bot_t>
+        merge_join (algebraic_generator<L, bot_t> const& left,
+                    algebraic_generator<R, bot_t> const& right,
+                    Key key, Compare cmp = Compare ())
+    {
+        using T = std::tuple<L, R>;
+        using A = algebraic::algebraic<T, bot_t>;
+
+        detail::merge_join_state<K, L, R> st;
+
+        return algebraic_generator<T, bot_t>
+            ([left,right,key,cmp,st] (void) mutable -> A
+            {
+                if (not st.started) {
+                    st.started = true;
+                    st.pull (right);
+                }
+
+                for (;;) {
+                    if (st.idx < st.group.size ())
+                        return A (T (st.left, st.group[st.idx++]));
+                    if (st.done)
+                        return A (bot_t{});
+
+                    auto const v = left ();
+                    if (is_bot (v)) {
+                        st.done = true;
+                        continue;
+                    }
+
+                    auto x = v.template value<L> ();
+                    K k = key (x);
+
+                    if (st.has_group && not cmp (st.group_key, k)) {
+                        // same key as the last left value
+                        st.left = std::move (x);
+                        st.idx  = 0;
+                        continue;
+                    }
+
+                    st.group.clear ();
+                    st.has_group = false;
+
+                    while (st.right_live && cmp (key (st.right), k))
+                        st.pull (right);
+                    if (not st.right_live) {
+                        st.done = true;
+                        continue;
+                    }
+                    if (cmp (k, key (st.right)))
+                        continue;
+
+                    while (st.right_live && not cmp (k, key (st.right))) {
+                        st.group.push_back (std::move (st.right));
+                        st.pull (right);
+                    }
+
+                    st.group_key = std::move (k);
+                    st.has_group = true;
+                    st.left = std::move (x);
+                    st.idx  = 0;
+                }
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_JOIN_HPP
@@ -0,0 +1,267 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// merge : k-way merge of sorted generators.
+//
+//      auto all = gcomb::merge (shard0, shard1, shard2);
+//
+//      std::vector<gcomb::algebraic_generator<record, gcomb::bot_t>> shards = ...;
+//      auto all = gcomb::merge (shards, by_key {});
+//
+// note:
+//      The inputs must each be sorted by the comparator (std::less by
+//      default); the output is their sorted union, keeping every value.
+//      Values that compare equal come out in input order, so the merge
+//      is stable. Bounded inputs may end at different times; the merge
+//      reverts to bot once they all have. Merging infinite generators
+//      gives an infinite generator.
+//
+//      The merge is a tournament (loser) tree: each internal node holds
+//      the index of the input that lost the match played there, and the
+//      overall winner sits at the root. Taking a value refills only the
+//      winner's leaf and replays the single path from it to the root,
+//      comparing against one stored loser per level: ceil (log2 k)
+//      comparisons per value, against 2 log2 k for a binary heap. Nodes
+//      are 32-bit indices in one array laid out heap fashion (node n's
+//      parent is n / 2), so the upper levels that every replay touches
+//      share a few cache lines; the current head of every input lives in
+//      a second contiguous array.
+//
+//      Inputs are first pulled on the first call, not on construction.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_MERGE_HPP
+#define GCOMB_MERGE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    template <typename T, typename Compare>
+    class loser_tree
+    {
+    public:
+        loser_tree (std::size_t k, Compare cmp)
+            : k (k), tree (k ? k : 1, 0), heads (k), live (k, 0), cmp (cmp)
+        {}
+
+        void set (std::size_t leaf, T value)
+        {
+            heads[leaf] = std::move (value);
+            live[leaf]  = 1;
+        }
+
+        void exhaust (std::size_t leaf) noexcept
+        {
+            live[leaf] = 0;
+        }
+
+        // play every match once all leaves are set
+        //
+        void build (void)
+        {
+            if (k < 2)
+                return;
+
+            std::vector<std::uint32_t> winner (2 * k);
+            for (std::size_t i = 0; i < k; ++i)
+                winner[k + i] = static_cast<std::uint32_t> (i);
+
+            for (std::size_t n = k - 1; n > 0; --n) {
+                auto const a = winner[2 * n];
+                auto const b = winner[2 * n + 1];
+                if (beats (b, a)) {
+                    tree[n]   = a;
+                    winner[n] = b;
+                } else {
+                    tree[n]   = b;
+                    winner[n] = a;
+                }
+            }
+
+            tree[0] = winner[1];
+        }
+
+        bool empty (void) const noexcept
+        {
+            return k == 0 || not live[tree[0]];
+        }
+
+        std::size_t top (void) const noexcept
+        {
+            return tree[0];
+        }
+
+        T & head (std::size_t leaf) noexcept
+        {
+            return heads[leaf];
+        }
+
+        // leaf has a new head (or is exhausted): replay its path
+        //
+        void replay (std::size_t leaf)
+        {
+            auto w = static_cast<std::uint32_t> (leaf);
+            for (auto n = (leaf + k) / 2; n > 0; n /= 2)
+                if (beats (tree[n], w))
+                    std::swap (tree[n], w);
+            tree[0] = w;
+        }
+
+    private:
+        // whether input a's head comes out before input b's
+        //
+        bool beats (std::uint32_t a, std::uint32_t b) const
+        {
+            if (not live[a])
+                return false;
+            if (not live[b])
+                return true;
+            if (cmp (heads[a], heads[b]))
+                return true;
+            return a < b && not cmp (heads[b], heads[a]);
+        }
+
+        std::size_t k;
+        std::vector<std::uint32_t> tree;    // [0]: winner, [1, k): losers
+        std::vector<T> heads;
+        std::vector<unsigned char> live;
+        Compare cmp;
+    };
+
+
+    template <typename T, typename Compare>
+    struct bounded_merge_state
+    {
+        bounded_merge_state (std::vector<algebraic_generator<T, bot_t>> const& gs,
+                             Compare cmp)
+            : inputs (gs), tree (gs.size (), cmp), started (false)
+        {}
+
+        void pull (std::size_t i)
+        {
+            auto const v = inputs[i] ();
+            if (is_bot (v))
+                tree.exhaust (i);
+            else
+                tree.set (i, v.template value<T> ());
+        }
+
+        std::vector<algebraic_generator<T, bot_t>> inputs;
+        loser_tree<T, Compare> tree;
+        bool started;
+    };
+
+
+    template <typename T, typename Compare>
+    struct merge_state
+    {
+        merge_state (std::vector<generator<T>> const& gs, Compare cmp)
+            : inputs (gs), tree (gs.size (), cmp), started (false)
+        {}
+
+        std::vector<generator<T>> inputs;
+        loser_tree<T, Compare> tree;
+        bool started;
+    };
+} // namespace detail
+
+    // merge any number of sorted bounded generators
+    //
+    template <typename T, typename Compare = std::less<T>>
+    algebraic_generator<T, bot_t>
+        merge (std::vector<algebraic_generator<T, bot_t>> const& gs,
+               Compare cmp = Compare ())
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        auto const st = std::make_shared<detail::bounded_merge_state<T, Compare>> (gs, cmp);
+
+        return algebraic_generator<T, bot_t>
+            ([st] (void) -> A
+            {
+                auto & tree = st->tree;
+
+                if (not st->started) {
+                    st->started = true;
+                    for (std::size_t i = 0; i < st->inputs.size (); ++i)
+                        st->pull (i);
+                    tree.build ();
+                }
+
+                if (tree.empty ())
+                    return A (bot_t{});
+
+                auto const w = tree.top ();
+                A out (std::move (tree.head (w)));
+
+                st->pull (w);
+                tree.replay (w);
+                return out;
+            });
+    }
+
+
+    // merge any number of sorted infinite generators
+    //
+    template <typename T, typename Compare = std::less<T>>
+    generator<T> merge (std::vector<generator<T>> const& gs,
+                        Compare cmp = Compare ())
+    {
+        if (gs.empty ())
+            throw std::invalid_argument ("gcomb: merge of no infinite generators");
+
+        auto const st = std::make_shared<detail::merge_state<T, Compare>> (gs, cmp);
+
+        return generator<T>
+            ([st] (void) -> T
+            {
+                auto & tree = st->tree;
+
+                if (not st->started) {
+                    st->started = true;
+                    for (std::size_t i = 0; i < st->inputs.size (); ++i)
+                        tree.set (i, st->inputs[i] ());
+                    tree.build ();
+                }
+
+                auto const w = tree.top ();
+                T out (std::move (tree.head (w)));
+
+                tree.set (w, st->inputs[w] ());
+                tree.replay (w);
+                return out;
+            });
+    }
+
+
+    template <typename T, typename ... Gs>
+    algebraic_generator<T, bot_t> merge (algebraic_generator<T, bot_t> const& g,
+                                         Gs const& ... gs)
+    {
+        return merge (std::vector<algebraic_generator<T, bot_t>> {g, gs...});
+    }
+
+
+    template <typename T, typename ... Gs>
+    generator<T> merge (generator<T> const& g, Gs const& ... gs)
+    {
+        return merge (std::vector<generator<T>> {g, gs...});
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_MERGE_HPP
@@ -0,0 +1,401 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// push : a push-mode execution engine for linear pipelines.
+//
+//      std::uint64_t total = 0;
+//
+//      gcomb::push::run (gcomb::push::count<std::uint64_t> (0, 1, n),
+//                        gcomb::push::bind ([] (std::uint64_t x) { return x * x; }),
+//                        gcomb::push::filter ([] (std::uint64_t x) { return x & 1; }),
+//                        gcomb::push::take (1000),
+//                        [&] (std::uint64_t x) { total += x; });
+//
+// note:
+//      The pull combinators (combinators.hpp) call upstream through a
+//      std::function at every stage, for every value. Here the source
+//      runs the loop instead and pushes each value into a chain of
+//      continuations: stage k wraps stage k+1 by value, and the chain's
+//      type is fully known at compile time, so the whole pipeline is
+//      inlined into the source's loop body with its state in registers.
+//
+//      Every continuation returns whether it wants more values; take,
+//      take_while or a sink returning false stop the source at once.
+//      The chain is also asked before the source starts, so a take (0)
+//      anywhere in it means no value is produced at all.
+//      A sink may return void (meaning: always more).
+//
+//      Sources:  from (generator, n), from (bounded generator),
+//                count (start, step, n), each (container or view)
+//      Stages:   bind (f), filter (pred), take (n), take_while (pred)
+//
+//      run (source, stages..., sink) drives the source to completion
+//      (or until something declines more values) and returns the sink.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_PUSH_HPP
+#define GCOMB_PUSH_HPP
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+
+namespace gcomb
+{
+namespace push
+{
+namespace detail
+{
+    // feed a sink, treating a void result as a request for more
+    //
+    template <typename S, typename T>
+    auto feed (S & s, T && v, int)
+        -> decltype (static_cast<bool> (s (std::forward<T> (v))))
+    {
+        return static_cast<bool> (s (std::forward<T> (v)));
+    }
+
+    template <typename S, typename T>
+    bool feed (S & s, T && v, long)
+    {
+        s (std::forward<T> (v));
+        return true;
+    }
+
+
+    // whether a continuation can accept any value at all; asked once,
+    // before the source starts, so e.g. take (0) pulls nothing
+    //
+    template <typename K>
+    auto wants_any (K const& k, int)
+        -> decltype (static_cast<bool> (k.wants_any ()))
+    {
+        return static_cast<bool> (k.wants_any ());
+    }
+
+    template <typename K>
+    bool wants_any (K const&, long)
+    {
+        return true;
+    }
+
+
+    template <typename S>
+    struct sink_ref
+    {
+        S * s;
+
+        template <typename T>
+        bool operator() (T && v)
+        {
+            return feed (*s, std::forward<T> (v), 0);
+        }
+    };
+
+
+    template <typename S>
+    sink_ref<S> chain (S & sink)
+    {
+        return sink_ref<S> {&sink};
+    }
+
+    template <typename Stage, typename ... Rest,
+        typename = typename std::enable_if<sizeof...(Rest) >= 1>::type>
+    auto chain (Stage & stage, Rest & ... rest)
+    {
+        return stage.wrap (chain (rest...));
+    }
+
+
+    template <typename Source, typename Tup, std::size_t ... I>
+    void run_impl (Source const& src, Tup & args, std::index_sequence<I...>)
+    {
+        auto k = chain (std::get<I> (args)...);
+        if (wants_any (k, 0))
+            src.run (k);
+    }
+
+
+    template <typename F, typename K>
+    struct bind_stage
+    {
+        F f;
+        K k;
+
+        template <typename T>
+        bool operator() (T && v)
+        {
+            return k (f (std::forward<T> (v)));
+        }
+
+        bool wants_any (void) const
+        {
+            return detail::wants_any (k, 0);
+        }
+    };
+
+    template <typename P, typename K>
+    struct filter_stage
+    {
+        P p;
+        K k;
+
+        template <typename T>
+        bool operator() (T && v)
+        {
+            return p (v) ? k (std::forward<T> (v)) : true;
+        }
+
+        bool wants_any (void) const
+        {
+            return detail::wants_any (k, 0);
+        }
+    };
+
+    template <typename K>
+    struct take_stage
+    {
+        std::size_t n;
+        K k;
+
+        template <typename T>
+        bool operator() (T && v)
+        {
+            if (n == 0)
+                return false;
+            --n;
+            return k (std::forward<T> (v)) && n != 0;
+        }
+
+        bool wants_any (void) const
+        {
+            return n != 0 && detail::wants_any (k, 0);
+        }
+    };
+
+    template <typename P, typename K>
+    struct take_while_stage
+    {
+        P p;
+        K k;
+
+        template <typename T>
+        bool operator() (T && v)
+        {
+            return p (v) && k (std::forward<T> (v));
+        }
+
+        bool wants_any (void) const
+        {
+            return detail::wants_any (k, 0);
+        }
+    };
+} // namespace detail
+
+//
+// stages
+//
+
+    template <typename F>
+    struct bind_t
+    {
+        F f;
+
+        template <typename K>
+        detail::bind_stage<F, K> wrap (K k) const
+        {
+            return {f, std::move (k)};
+        }
+    };
+
+    template <typename F>
+    bind_t<typename std::decay<F>::type> bind (F && f)
+    {
+        return {std::forward<F> (f)};
+    }
+
+
+    template <typename P>
+    struct filter_t
+    {
+        P p;
+
+        template <typename K>
+        detail::filter_stage<P, K> wrap (K k) const
+        {
+            return {p, std::move (k)};
+        }
+    };
+
+    template <typename P>
+    filter_t<typename std::decay<P>::type> filter (P && p)
+    {
+        return {std::forward<P> (p)};
+    }
+
+
+    struct take_t
+    {
+        std::size_t n;
+
+        template <typename K>
+        detail::take_stage<K> wrap (K k) const
+        {
+            return {n, std::move (k)};
+        }
+    };
+
+    inline take_t take (std::size_t n) noexcept
+    {
+        return {n};
+    }
+
+
+    template <typename P>
+    struct take_while_t
+    {
+        P p;
+
+        template <typename K>
+        detail::take_while_stage<P, K> wrap (K k) const
+        {
+            return {p, std::move (k)};
+        }
+    };
+
+    template <typename P>
+    take_while_t<typename std::decay<P>::type> take_while (P && p)
+    {
+        return {std::forward<P> (p)};
+    }
+
+//
+// sources
+//
+
+    template <typename T>
+    struct generator_source
+    {
+        generator<T> g;
+        std::size_t n;
+
+        template <typename K>
+        void run (K & k) const
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                if (not k (g ()))
+                    return;
+        }
+    };
+
+    // the first n values of an infinite generator
+    //
+    template <typename T>
+    generator_source<T> from (generator<T> const& g, std::size_t n)
+    {
+        return {g, n};
+    }
+
+
+    template <typename T>
+    struct bounded_source
+    {
+        algebraic_generator<T, bot_t> g;
+
+        template <typename K>
+        void run (K & k) const
+        {
+            for (;;) {
+                auto const v = g ();
+                if (is_bot (v) || not k (v.template value<T> ()))
+                    return;
+            }
+        }
+    };
+
+    // every value of a bounded generator
+    //
+    template <typename T>
+    bounded_source<T> from (algebraic_generator<T, bot_t> const& g)
+    {
+        return {g};
+    }
+
+
+    template <typename T>
+    struct count_source
+    {
+        T start;
+        T step;
+        std::size_t n;
+
+        template <typename K>
+        void run (K & k) const
+        {
+            auto v = start;
+            for (std::size_t i = 0; i < n; ++i, v += step)
+                if (not k (v))
+                    return;
+        }
+    };
+
+    // start, start + step, ... (n values); the push analogue of count
+    //
+    template <typename T,
+        typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    count_source<T> count (T start, T step, std::size_t n)
+    {
+        return {start, step, n};
+    }
+
+
+    template <typename C>
+    struct each_source
+    {
+        C const* c;
+
+        template <typename K>
+        void run (K & k) const
+        {
+            for (auto const& v : *c)
+                if (not k (v))
+                    return;
+        }
+    };
+
+    // the elements of a container (or view), which must outlive the run
+    //
+    template <typename C>
+    each_source<C> each (C const& c)
+    {
+        return {&c};
+    }
+
+//
+// execution
+//
+
+    // drive source through stages into the sink (the last argument);
+    // returns the sink.
+    //
+    template <typename Source, typename ... Args,
+        typename = typename std::enable_if<sizeof...(Args) >= 1>::type>
+    auto run (Source const& src, Args ... args)
+        -> typename std::tuple_element<sizeof...(Args) - 1, std::tuple<Args...>>::type
+    {
+        std::tuple<Args...> chain (std::move (args)...);
+        detail::run_impl (src, chain, std::index_sequence_for<Args...> {});
+        return std::move (std::get<sizeof...(Args) - 1> (chain));
+    }
+} // namespace push
+} // namespace gcomb
+
+#endif // ifndef GCOMB_PUSH_HPP
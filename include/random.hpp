@@ -0,0 +1,503 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// random : counter-based random number sources.
+//
+//      // uniform doubles in [0, 1), stream 3 of seed 42
+//      auto u = gcomb::random_values (42, gcomb::uniform_real<double> {}, 3);
+//
+//      // the same values, 4096 at a time
+//      auto b = gcomb::random_batches (42, gcomb::uniform_real<double> {}, 4096, 3);
+//
+//      // value i, directly
+//      gcomb::philox rng (42, 3);
+//      double x = rng.at (i, gcomb::uniform_real<double> {});
+//
+//      // composed with count: the even-indexed values only
+//      auto even = gcomb::bind ([rng] (std::uint64_t i)
+//                               { return rng.at (i, gcomb::normal_real<float> {}); },
+//                               gcomb::count<std::uint64_t> (0, 2));
+//
+// note:
+//      The generator is Philox4x32-10 (Salmon et al., "Parallel random
+//      numbers: as easy as 1, 2, 3", SC 2011): a keyed bijection of a
+//      128-bit counter, with no state besides the key. Here the key is
+//      the 64-bit seed and the counter is (block number, stream), so
+//      each seed has 2^64 independent streams of 2^64 blocks of four
+//      32-bit words. Value i of a stream is a pure function of
+//      (seed, stream, i, distribution): jumping ahead is free, and
+//      threads can split a stream by offset or take a stream each with
+//      nothing shared. Results are identical whichever way (at, fill,
+//      random_values or random_batches) and in whatever pieces they are
+//      drawn.
+//
+//      Each block yields a fixed number of values of a distribution:
+//
+//          uniform_bits<std::uint32_t>     4, the words themselves
+//          uniform_bits<std::uint64_t>     2
+//          uniform_real<float>             4, 24 bit multiples of 2^-24
+//          uniform_real<double>            2, 52 bit multiples of 2^-52
+//          normal_real<float/double>       4 / 2, by Box-Muller
+//          uniform_below {n}               2, in [0, n) by 64-bit
+//                                          multiply-shift (bias < n / 2^64)
+//
+//      With AVX2, blocks are generated eight at a time, one per vector
+//      lane, at about twice the scalar rate. There is no SSE2 kernel:
+//      the scalar code gets both halves of a product from one 64-bit
+//      multiply, and rebuilding them from 32-bit lanes made four lanes
+//      no faster. The uniform conversions are vectorised with SSE2; the
+//      normal transform is scalar (it needs log, sin and cos). The
+//      generator sources fill a buffer of 256 values at a time through
+//      the same batch path.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_RANDOM_HPP
+#define GCOMB_RANDOM_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "generator.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    constexpr std::uint32_t philox_m0 = 0xd2511f53;
+    constexpr std::uint32_t philox_m1 = 0xcd9e8d57;
+    constexpr std::uint32_t philox_w0 = 0x9e3779b9;
+    constexpr std::uint32_t philox_w1 = 0xbb67ae85;
+
+
+    // one Philox4x32-10 block
+    //
+    inline void philox_block (std::uint32_t const (&ctr)[4],
+                              std::uint32_t k0, std::uint32_t k1,
+                              std::uint32_t * out) noexcept
+    {
+        std::uint32_t x0 = ctr[0], x1 = ctr[1], x2 = ctr[2], x3 = ctr[3];
+
+        for (int r = 0; r < 10; ++r) {
+            auto const p0 = std::uint64_t (philox_m0) * x0;
+            auto const p1 = std::uint64_t (philox_m1) * x2;
+
+            auto const y0 = static_cast<std::uint32_t> (p1 >> 32) ^ x1 ^ k0;
+            auto const y2 = static_cast<std::uint32_t> (p0 >> 32) ^ x3 ^ k1;
+
+            x0 = y0;
+            x1 = static_cast<std::uint32_t> (p1);
+            x2 = y2;
+            x3 = static_cast<std::uint32_t> (p0);
+
+            k0 += philox_w0;
+            k1 += philox_w1;
+        }
+
+        out[0] = x0; out[1] = x1; out[2] = x2; out[3] = x3;
+    }
+
+
+#if defined(__AVX2__)
+    // 32 x 32 -> 64 bit products of every lane: lo and hi halves
+    //
+    inline void philox_mulhilo (__m256i a, __m256i m, __m256i & lo, __m256i & hi) noexcept
+    {
+        auto const even = _mm256_mul_epu32 (a, m);
+        auto const odd  = _mm256_mul_epu32 (_mm256_srli_epi64 (a, 32), m);
+
+        lo = _mm256_blend_epi32 (even, _mm256_slli_epi64 (odd, 32), 0xaa);
+        hi = _mm256_blend_epi32 (_mm256_srli_epi64 (even, 32), odd, 0xaa);
+    }
+
+
+    // eight consecutive blocks, one per lane
+    //
+    inline void philox_block8 (std::uint64_t n, std::uint32_t s0, std::uint32_t s1,
+                               std::uint32_t k0, std::uint32_t k1,
+                               std::uint32_t * out) noexcept
+    {
+        std::uint32_t lo[8], hi[8];
+        for (int j = 0; j < 8; ++j) {
+            lo[j] = static_cast<std::uint32_t> (n + j);
+            hi[j] = static_cast<std::uint32_t> ((n + j) >> 32);
+        }
+
+        auto x0 = _mm256_loadu_si256 (reinterpret_cast<__m256i const*> (lo));
+        auto x1 = _mm256_loadu_si256 (reinterpret_cast<__m256i const*> (hi));
+        auto x2 = _mm256_set1_epi32 (static_cast<int> (s0));
+        auto x3 = _mm256_set1_epi32 (static_cast<int> (s1));
+
+        auto const m0 = _mm256_set1_epi32 (static_cast<int> (philox_m0));
+        auto const m1 = _mm256_set1_epi32 (static_cast<int> (philox_m1));
+
+        for (int r = 0; r < 10; ++r) {
+            __m256i lo0, hi0, lo1, hi1;
+            philox_mulhilo (x0, m0, lo0, hi0);
+            philox_mulhilo (x2, m1, lo1, hi1);
+
+            x0 = _mm256_xor_si256 (_mm256_xor_si256 (hi1, x1),
+                                   _mm256_set1_epi32 (static_cast<int> (k0)));
+            x1 = lo1;
+            x2 = _mm256_xor_si256 (_mm256_xor_si256 (hi0, x3),
+                                   _mm256_set1_epi32 (static_cast<int> (k1)));
+            x3 = lo0;
+
+            k0 += philox_w0;
+            k1 += philox_w1;
+        }
+
+        // lanes are blocks; transpose within each half (blocks 0-3 low,
+        // 4-7 high), then store block by block
+        auto const t0 = _mm256_unpacklo_epi32 (x0, x1);
+        auto const t1 = _mm256_unpacklo_epi32 (x2, x3);
+        auto const t2 = _mm256_unpackhi_epi32 (x0, x1);
+        auto const t3 = _mm256_unpackhi_epi32 (x2, x3);
+
+        auto const b0 = _mm256_unpacklo_epi64 (t0, t1);
+        auto const b1 = _mm256_unpackhi_epi64 (t0, t1);
+        auto const b2 = _mm256_unpacklo_epi64 (t2, t3);
+        auto const b3 = _mm256_unpackhi_epi64 (t2, t3);
+
+        auto * o = reinterpret_cast<__m256i *> (out);
+        _mm256_storeu_si256 (o + 0, _mm256_permute2x128_si256 (b0, b1, 0x20));
+        _mm256_storeu_si256 (o + 1, _mm256_permute2x128_si256 (b2, b3, 0x20));
+        _mm256_storeu_si256 (o + 2, _mm256_permute2x128_si256 (b0, b1, 0x31));
+        _mm256_storeu_si256 (o + 3, _mm256_permute2x128_si256 (b2, b3, 0x31));
+    }
+#endif
+
+
+    inline std::uint64_t word64 (std::uint32_t const* w) noexcept
+    {
+        return std::uint64_t (w[0]) | (std::uint64_t (w[1]) << 32);
+    }
+
+
+    inline std::uint64_t mulhi64 (std::uint64_t a, std::uint64_t b) noexcept
+    {
+    #if defined(__SIZEOF_INT128__)
+        // __extension__ keeps -Wpedantic quiet about the non-ISO type
+        __extension__ typedef unsigned __int128 u128;
+        return static_cast<std::uint64_t> ((static_cast<u128> (a) * b) >> 64);
+    #else
+        auto const a0 = a & 0xffffffff, a1 = a >> 32;
+        auto const b0 = b & 0xffffffff, b1 = b >> 32;
+        auto const mid = a1 * b0 + ((a0 * b0) >> 32);
+        return a1 * b1 + (mid >> 32) + ((a0 * b1 + (mid & 0xffffffff)) >> 32);
+    #endif
+    }
+
+
+    // one Box-Muller pair from u1 in (0, 1] and u2 in [0, 1)
+    //
+    template <typename T>
+    void box_muller (double u1, double u2, T * out) noexcept
+    {
+        auto const r = std::sqrt (-2.0 * std::log (u1));
+        auto const t = 6.283185307179586 * u2;
+        out[0] = static_cast<T> (r * std::cos (t));
+        out[1] = static_cast<T> (r * std::sin (t));
+    }
+} // namespace detail
+
+    // the raw words of each block
+    //
+    template <typename T>
+    struct uniform_bits
+    {
+        static_assert (std::is_same<T, std::uint32_t>::value ||
+                       std::is_same<T, std::uint64_t>::value,
+                       "uniform_bits is over std::uint32_t or std::uint64_t");
+
+        using result_type = T;
+        static constexpr std::size_t per_block = 16 / sizeof (T);
+
+        void convert (std::uint32_t const* w, std::size_t blocks, T * out) const noexcept
+        {
+            for (std::size_t i = 0; i < blocks * per_block; ++i)
+                out[i] = sizeof (T) == 4 ? T (w[i]) : T (detail::word64 (w + 2 * i));
+        }
+    };
+
+
+    // uniform on [0, 1)
+    //
+    template <typename T>
+    struct uniform_real;
+
+    template <>
+    struct uniform_real<float>
+    {
+        using result_type = float;
+        static constexpr std::size_t per_block = 4;
+
+        void convert (std::uint32_t const* w, std::size_t blocks, float * out) const noexcept
+        {
+            std::size_t i = 0;
+        #if defined(__SSE2__)
+            auto const scale = _mm_set1_ps (1.0f / 16777216.0f);
+            for (; i < blocks * 4; i += 4) {
+                auto const x = _mm_loadu_si128 (reinterpret_cast<__m128i const*> (w + i));
+                _mm_storeu_ps (out + i, _mm_mul_ps (_mm_cvtepi32_ps (_mm_srli_epi32 (x, 8)), scale));
+            }
+        #endif
+            for (; i < blocks * 4; ++i)
+                out[i] = static_cast<float> (w[i] >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    template <>
+    struct uniform_real<double>
+    {
+        using result_type = double;
+        static constexpr std::size_t per_block = 2;
+
+        void convert (std::uint32_t const* w, std::size_t blocks, double * out) const noexcept
+        {
+            // 52 random bits as the mantissa of a double in [1, 2)
+            std::size_t i = 0;
+        #if defined(__SSE2__)
+            auto const one = _mm_set1_epi64x (0x3ff0000000000000ll);
+            for (; i < blocks * 2; i += 2) {
+                auto x = _mm_loadu_si128 (reinterpret_cast<__m128i const*> (w + 2 * i));
+                x = _mm_or_si128 (_mm_srli_epi64 (x, 12), one);
+                _mm_storeu_pd (out + i, _mm_sub_pd (_mm_castsi128_pd (x), _mm_set1_pd (1.0)));
+            }
+        #endif
+            for (; i < blocks * 2; ++i) {
+                auto const bits = (detail::word64 (w + 2 * i) >> 12) | 0x3ff0000000000000ull;
+                double d;
+                std::memcpy (&d, &bits, sizeof d);
+                out[i] = d - 1.0;
+            }
+        }
+    };
+
+
+    // standard normal
+    //
+    template <typename T>
+    struct normal_real;
+
+    template <>
+    struct normal_real<float>
+    {
+        using result_type = float;
+        static constexpr std::size_t per_block = 4;
+
+        void convert (std::uint32_t const* w, std::size_t blocks, float * out) const noexcept
+        {
+            for (std::size_t i = 0; i < blocks * 4; i += 2)
+                detail::box_muller (((w[i] >> 8) + 1) * (1.0 / 16777216.0),
+                                    (w[i + 1] >> 8) * (1.0 / 16777216.0), out + i);
+        }
+    };
+
+    template <>
+    struct normal_real<double>
+    {
+        using result_type = double;
+        static constexpr std::size_t per_block = 2;
+
+        void convert (std::uint32_t const* w, std::size_t blocks, double * out) const noexcept
+        {
+            for (std::size_t i = 0; i < blocks * 2; i += 2)
+                detail::box_muller (((detail::word64 (w + 2 * i) >> 11) + 1) * (1.0 / 9007199254740992.0),
+                                    (detail::word64 (w + 2 * i + 2) >> 11) * (1.0 / 9007199254740992.0), out + i);
+        }
+    };
+
+
+    // uniform on [0, n)
+    //
+    struct uniform_below
+    {
+        using result_type = std::uint64_t;
+        static constexpr std::size_t per_block = 2;
+
+        std::uint64_t n;
+
+        void convert (std::uint32_t const* w, std::size_t blocks, std::uint64_t * out) const noexcept
+        {
+            for (std::size_t i = 0; i < blocks * 2; ++i)
+                out[i] = detail::mulhi64 (detail::word64 (w + 2 * i), n);
+        }
+    };
+
+
+    // Philox4x32-10 keyed by seed, on one stream
+    //
+    class philox
+    {
+    public:
+        explicit philox (std::uint64_t seed, std::uint64_t stream = 0) noexcept
+            : k0 (static_cast<std::uint32_t> (seed)),
+              k1 (static_cast<std::uint32_t> (seed >> 32)),
+              s0 (static_cast<std::uint32_t> (stream)),
+              s1 (static_cast<std::uint32_t> (stream >> 32))
+        {}
+
+        // the four words of block n
+        //
+        std::array<std::uint32_t, 4> block (std::uint64_t n) const noexcept
+        {
+            std::array<std::uint32_t, 4> out;
+            blocks (n, 1, out.data ());
+            return out;
+        }
+
+        // blocks [first, first + n) into out (4 n words)
+        //
+        void blocks (std::uint64_t first, std::size_t n, std::uint32_t * out) const noexcept
+        {
+        #if defined(__AVX2__)
+            for (; n >= 8; n -= 8, first += 8, out += 32)
+                detail::philox_block8 (first, s0, s1, k0, k1, out);
+        #endif
+            for (; n; --n, ++first, out += 4) {
+                std::uint32_t const ctr[4] = {static_cast<std::uint32_t> (first),
+                                              static_cast<std::uint32_t> (first >> 32), s0, s1};
+                detail::philox_block (ctr, k0, k1, out);
+            }
+        }
+
+        // values [first, first + n) of distribution d into out
+        //
+        template <typename Dist>
+        void fill (std::uint64_t first, typename Dist::result_type * out,
+                   std::size_t n, Dist const& d) const
+        {
+            using T = typename Dist::result_type;
+            constexpr std::size_t per = Dist::per_block;
+            constexpr std::size_t batch = 64;
+
+            std::uint32_t words[4 * batch];
+            T part[per];
+
+            auto b = first / per;
+            auto const skip = static_cast<std::size_t> (first % per);
+
+            if (skip && n) {
+                blocks (b++, 1, words);
+                d.convert (words, 1, part);
+                auto const k = std::min (n, per - skip);
+                std::copy (part + skip, part + skip + k, out);
+                out += k;
+                n -= k;
+            }
+
+            while (n >= per) {
+                auto const m = std::min (batch, n / per);
+                blocks (b, m, words);
+                d.convert (words, m, out);
+                b   += m;
+                out += m * per;
+                n   -= m * per;
+            }
+
+            if (n) {
+                blocks (b, 1, words);
+                d.convert (words, 1, part);
+                std::copy (part, part + n, out);
+            }
+        }
+
+        // value i of distribution d
+        //
+        template <typename Dist>
+        typename Dist::result_type at (std::uint64_t i, Dist const& d) const
+        {
+            typename Dist::result_type out[Dist::per_block];
+            fill (i, out, 1, d);
+            return out[0];
+        }
+
+    private:
+        std::uint32_t k0, k1;
+        std::uint32_t s0, s1;
+    };
+
+namespace detail
+{
+    template <typename Dist>
+    struct random_state
+    {
+        random_state (philox const& rng, Dist const& d, std::uint64_t next, std::size_t n)
+            : rng (rng), d (d), buf (n), next (next), pos (n)
+        {}
+
+        void refill (void)
+        {
+            rng.fill (next, buf.data (), buf.size (), d);
+            next += buf.size ();
+            pos = 0;
+        }
+
+        philox rng;
+        Dist d;
+        std::vector<typename Dist::result_type> buf;
+        std::uint64_t next;     // index of the value after buf
+        std::size_t pos;
+    };
+} // namespace detail
+
+    // values offset, offset + 1, ... of distribution d on one stream of seed
+    //
+    template <typename Dist>
+    generator<typename Dist::result_type>
+        random_values (std::uint64_t seed, Dist d,
+                       std::uint64_t stream = 0, std::uint64_t offset = 0)
+    {
+        using T = typename Dist::result_type;
+
+        detail::random_state<Dist> st (philox (seed, stream), d, offset, 256);
+
+        return generator<T>
+            ([st] (void) mutable -> T
+            {
+                if (st.pos == st.buf.size ())
+                    st.refill ();
+                return st.buf[st.pos++];
+            });
+    }
+
+
+    // the same values as random_values, n at a time, as views (valid
+    // until the next call) into one reused buffer.
+    //
+    template <typename Dist>
+    generator<view<typename Dist::result_type>>
+        random_batches (std::uint64_t seed, Dist d, std::size_t n,
+                        std::uint64_t stream = 0, std::uint64_t offset = 0)
+    {
+        using T = typename Dist::result_type;
+
+        detail::random_state<Dist> st (philox (seed, stream), d, offset, n ? n : 1);
+
+        return generator<view<T>>
+            ([st] (void) mutable -> view<T>
+            {
+                st.refill ();
+                return make_view (static_cast<T const*> (st.buf.data ()), st.buf.size ());
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_RANDOM_HPP
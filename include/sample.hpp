@@ -0,0 +1,365 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// sample : uniform and weighted reservoir sampling.
+//
+//      // 1000 events, uniformly, from a bounded stream
+//      std::vector<event> s = gcomb::sample (events, 1000);
+//
+//      // from an infinite stream, for ten seconds
+//      auto s = gcomb::sample (feed, 1000, std::chrono::seconds (10));
+//
+//      // each event kept with probability proportional to its size
+//      auto s = gcomb::sample_weighted (events, 1000,
+//                                       [] (event const& e) { return e.bytes; });
+//
+//      // or as sinks, e.g. alongside others with broadcast
+//      gcomb::reservoir<event> r (1000, seed);
+//      ...
+//      r (e);
+//      r.values ();
+//
+// note:
+//      reservoir is Algorithm L (Li, "Reservoir-sampling algorithms of
+//      time complexity O(n(1 + log(N/n)))", 1994): after the reservoir
+//      fills, the number of values to pass over before the next
+//      replacement is drawn from its (geometric-like) distribution, so
+//      random numbers are drawn only on replacements, O(k log (n / k))
+//      of them, rather than one per value. Values in between cost one
+//      decrement; a batch (view) skips them without looking at them.
+//
+//      weighted_reservoir is A-ExpJ (Efraimidis and Spirakis, "Weighted
+//      random sampling with a reservoir", 2006): value i gets the key
+//      u^(1 / w_i) and the k largest keys are kept; instead of a key per
+//      value it draws the total weight to pass over before the next
+//      value that enters. Keys are kept as logarithms for accuracy with
+//      large weights. Values with weight 0 (or less) are never taken.
+//
+//      Randomness comes from a philox stream (see random.hpp) of the
+//      given seed, so a sample is reproducible from its seed and input.
+//      The values of a reservoir are in no particular order.
+//
+//      A time-limited sample checks the clock once every 1024 values.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_SAMPLE_HPP
+#define GCOMB_SAMPLE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "random.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    // uniform doubles in the open interval (0, 1)
+    //
+    class sample_rng
+    {
+    public:
+        explicit sample_rng (std::uint64_t seed) noexcept
+            : rng (seed), i (0)
+        {}
+
+        double operator() (void) noexcept
+        {
+            auto const x = rng.at (i++, uniform_bits<std::uint64_t> {});
+            return (static_cast<double> (x >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+        }
+
+    private:
+        philox rng;
+        std::uint64_t i;
+    };
+} // namespace detail
+
+    // uniform sample of k values (Algorithm L)
+    //
+    template <typename T>
+    class reservoir
+    {
+    public:
+        explicit reservoir (std::size_t k, std::uint64_t seed = 0)
+            : k (k), rand (seed), w (1.0), skip (0), n (0)
+        {
+            items.reserve (k);
+        }
+
+        void operator() (T const& value)
+        {
+            ++n;
+            if (items.size () < k)
+                fill (value);
+            else if (skip)
+                --skip;
+            else if (k)
+                replace (value);
+        }
+
+        // offer every value of a batch; skipped values are not read
+        //
+        void batch (view<T> const& values)
+        {
+            auto p = values.begin ();
+            auto const end = values.end ();
+            n += values.size ();
+            if (k == 0)
+                return;
+
+            while (p != end && items.size () < k)
+                fill (*p++);
+
+            while (p != end) {
+                auto const left = static_cast<std::size_t> (end - p);
+                if (skip >= left) {
+                    skip -= left;
+                    return;
+                }
+                p += skip;
+                replace (*p++);
+            }
+        }
+
+        std::vector<T> const& values (void) const noexcept
+        {
+            return items;
+        }
+
+        // values offered so far
+        //
+        std::uint64_t seen (void) const noexcept
+        {
+            return n;
+        }
+
+    private:
+        void fill (T const& value)
+        {
+            items.push_back (value);
+            if (items.size () == k)
+                advance ();
+        }
+
+        void replace (T const& value)
+        {
+            auto const j = static_cast<std::size_t> (rand () * k);
+            items[j < k ? j : k - 1] = value;
+            advance ();
+        }
+
+        // draw the next threshold and the gap until it is crossed
+        //
+        void advance (void)
+        {
+            w *= std::exp (std::log (rand ()) / static_cast<double> (k));
+
+            auto const gap = std::floor (std::log (rand ()) / std::log1p (-w));
+            skip = gap < 1.8e19 ? static_cast<std::uint64_t> (gap)
+                                : std::numeric_limits<std::uint64_t>::max ();
+        }
+
+        std::size_t k;
+        detail::sample_rng rand;
+        std::vector<T> items;
+        double w;
+        std::uint64_t skip;     // values to pass before the next replacement
+        std::uint64_t n;
+    };
+
+
+    // weighted sample of k values without replacement (A-ExpJ)
+    //
+    template <typename T>
+    class weighted_reservoir
+    {
+    public:
+        explicit weighted_reservoir (std::size_t k, std::uint64_t seed = 0)
+            : k (k), rand (seed), jump (0), n (0)
+        {
+            heap.reserve (k);
+        }
+
+        void operator() (T const& value, double weight)
+        {
+            ++n;
+            if (not (weight > 0.0) || k == 0)
+                return;
+
+            if (heap.size () < k) {
+                heap.emplace_back (std::log (rand ()) / weight, value);
+                std::push_heap (heap.begin (), heap.end (), later);
+                if (heap.size () == k)
+                    advance ();
+                return;
+            }
+
+            jump -= weight;
+            if (jump > 0.0)
+                return;
+
+            // enters with a key above the current minimum
+            auto const t = std::exp (weight * threshold ());
+            auto const r = t + rand () * (1.0 - t);
+
+            std::pop_heap (heap.begin (), heap.end (), later);
+            heap.back () = entry (std::log (r) / weight, value);
+            std::push_heap (heap.begin (), heap.end (), later);
+            advance ();
+        }
+
+        // the sampled values, in no particular order
+        //
+        std::vector<T> values (void) const
+        {
+            std::vector<T> out;
+            out.reserve (heap.size ());
+            for (auto const& e : heap)
+                out.push_back (e.second);
+            return out;
+        }
+
+        // values offered so far
+        //
+        std::uint64_t seen (void) const noexcept
+        {
+            return n;
+        }
+
+    private:
+        using entry = std::pair<double, T>;     // (log key, value)
+
+        static bool later (entry const& a, entry const& b) noexcept
+        {
+            return a.first > b.first;
+        }
+
+        // log of the smallest key kept
+        //
+        double threshold (void) const noexcept
+        {
+            return heap.front ().first;
+        }
+
+        // the weight to pass over before the next value enters
+        //
+        void advance (void)
+        {
+            jump = std::log (rand ()) / threshold ();
+        }
+
+        std::size_t k;
+        detail::sample_rng rand;
+        std::vector<entry> heap;    // min-heap on key
+        double jump;
+        std::uint64_t n;
+    };
+
+    // k values of a bounded generator, uniformly at random
+    //
+    template <typename T>
+    std::vector<T> sample (algebraic_generator<T, bot_t> const& g, std::size_t k,
+                           std::uint64_t seed = 0)
+    {
+        reservoir<T> r (k, seed);
+        for (;;) {
+            auto const v = g ();
+            if (is_bot (v))
+                return r.values ();
+            r (v.template value<T> ());
+        }
+    }
+
+
+    // k values of a stream of batches
+    //
+    template <typename T>
+    std::vector<T> sample (algebraic_generator<view<T>, bot_t> const& batches,
+                           std::size_t k, std::uint64_t seed = 0)
+    {
+        reservoir<T> r (k, seed);
+        for (;;) {
+            auto const v = batches ();
+            if (is_bot (v))
+                return r.values ();
+            r.batch (v.template value<view<T>> ());
+        }
+    }
+
+
+    // k values of whatever an infinite generator produces within limit
+    //
+    template <typename T, typename Rep, typename Period>
+    std::vector<T> sample (generator<T> const& g, std::size_t k,
+                           std::chrono::duration<Rep, Period> limit,
+                           std::uint64_t seed = 0)
+    {
+        auto const deadline = std::chrono::steady_clock::now () + limit;
+
+        reservoir<T> r (k, seed);
+        do {
+            for (int i = 0; i < 1024; ++i)
+                r (g ());
+        } while (std::chrono::steady_clock::now () < deadline);
+
+        return r.values ();
+    }
+
+
+    // k values of a bounded generator, each drawn with probability
+    // proportional to weight (value)
+    //
+    template <typename T, typename Weight>
+    std::vector<T> sample_weighted (algebraic_generator<T, bot_t> const& g,
+                                    std::size_t k, Weight weight,
+                                    std::uint64_t seed = 0)
+    {
+        weighted_reservoir<T> r (k, seed);
+        for (;;) {
+            auto const v = g ();
+            if (is_bot (v))
+                return r.values ();
+
+            auto const& x = v.template value<T> ();
+            r (x, static_cast<double> (weight (x)));
+        }
+    }
+
+
+    // weighted sample of an infinite generator within limit
+    //
+    template <typename T, typename Weight, typename Rep, typename Period>
+    std::vector<T> sample_weighted (generator<T> const& g, std::size_t k,
+                                    Weight weight,
+                                    std::chrono::duration<Rep, Period> limit,
+                                    std::uint64_t seed = 0)
+    {
+        auto const deadline = std::chrono::steady_clock::now () + limit;
+
+        weighted_reservoir<T> r (k, seed);
+        do {
+            for (int i = 0; i < 1024; ++i) {
+                auto const x = g ();
+                r (x, static_cast<double> (weight (x)));
+            }
+        } while (std::chrono::steady_clock::now () < deadline);
+
+        return r.values ();
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_SAMPLE_HPP
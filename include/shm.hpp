@@ -0,0 +1,442 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// shm : moving trivially copyable values between processes
+//       through a single producer/single consumer ring buffer
+//       in POSIX shared memory.
+//
+//      process A:  gcomb::shm_sink ("/stage1", gcomb::bound (g, n));
+//      process B:  auto g = gcomb::shm_source<T> ("/stage1");
+//
+// note:
+//      Both ends open (creating if need be) the named segment, so
+//      either side may start first; they must agree on T and on the
+//      ring capacity. The source unlinks the name when destroyed;
+//      shm_remove clears a segment left behind by a crashed pipeline.
+//
+//      Only an explicit close ends the stream cleanly: a writer
+//      destroyed without one (shm_sink unwinding from an exception, say)
+//      marks it aborted, and the source throws once it has passed on the
+//      values that did arrive.
+//
+//      The ring itself is lock-free. A side finding it empty (or full)
+//      spins and yields briefly, then sleeps on a futex in the shared segment; the
+//      other side only issues a wake-up syscall when a sleeper has
+//      announced itself. Linux only (futex).
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_SHM_HPP
+#define GCOMB_SHM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "sync.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    static_assert (ATOMIC_INT_LOCK_FREE == 2,
+        "shared memory rings need address-free 32-bit atomics");
+
+    struct shm_ring_header
+    {
+        std::atomic<std::uint32_t> state;       // 0 fresh, 1 initializing, 2 ready
+        std::uint32_t capacity;                 // elements, a power of two
+        std::uint32_t elem_size;
+
+        // consumer position; the producer sleeps on space_event
+        alignas (64) std::atomic<std::uint32_t> head;
+        std::atomic<std::uint32_t> producer_waiting;
+        std::atomic<std::uint32_t> space_event;
+
+        // producer position; the consumer sleeps on data_event
+        alignas (64) std::atomic<std::uint32_t> tail;
+        std::atomic<std::uint32_t> consumer_waiting;
+        std::atomic<std::uint32_t> data_event;
+        std::atomic<std::uint32_t> closed;      // 0 open, 1 closed, 2 aborted
+
+        alignas (64) unsigned char data[1];
+    };
+
+
+    class shm_ring
+    {
+    public:
+        shm_ring (std::string const& name, std::size_t capacity,
+                  std::size_t elem_size, bool owner)
+            : name (name), owner (owner)
+        {
+            std::size_t cap = 1;
+            while (cap < capacity)
+                cap <<= 1;
+
+            if (cap > (1u << 30))
+                throw std::invalid_argument ("gcomb: shm ring capacity too large");
+
+            length = offsetof (shm_ring_header, data) + cap * elem_size;
+
+            fd.fd = ::shm_open (name.c_str (), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+            if (fd.fd < 0)
+                throw_errno ("shm_open " + name);
+
+            // both ends size the segment identically; new pages read as zero
+            struct stat sb;
+            if (::fstat (fd.fd, &sb) != 0)
+                throw_errno ("stat " + name);
+            if (static_cast<std::size_t> (sb.st_size) < length &&
+                ::ftruncate (fd.fd, static_cast<off_t> (length)) != 0)
+                throw_errno ("ftruncate " + name);
+
+            auto const addr = ::mmap (nullptr, length, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED, fd.fd, 0);
+            if (addr == MAP_FAILED)
+                throw_errno ("mmap " + name);
+
+            hdr = static_cast<shm_ring_header *> (addr);
+
+            std::uint32_t fresh = 0;
+            if (hdr->state.compare_exchange_strong (fresh, 1)) {
+                hdr->capacity  = static_cast<std::uint32_t> (cap);
+                hdr->elem_size = static_cast<std::uint32_t> (elem_size);
+                hdr->state.store (2, std::memory_order_release);
+            } else {
+                while (hdr->state.load (std::memory_order_acquire) != 2)
+                    cpu_relax ();
+            }
+
+            if (hdr->capacity != cap || hdr->elem_size != elem_size) {
+                ::munmap (hdr, length);
+                throw std::invalid_argument
+                    ("gcomb: shm ring " + name + " has a different layout");
+            }
+
+            mask = static_cast<std::uint32_t> (cap - 1);
+            head = hdr->head.load (std::memory_order_relaxed);
+            tail = hdr->tail.load (std::memory_order_relaxed);
+        }
+
+        shm_ring (shm_ring const&) = delete;
+        shm_ring & operator= (shm_ring const&) = delete;
+
+        shm_ring (shm_ring && other) noexcept
+            : name (std::move (other.name)), owner (other.owner),
+              fd (std::move (other.fd)), length (other.length),
+              hdr (other.hdr), mask (other.mask),
+              head (other.head), tail (other.tail)
+        {
+            other.owner = false;
+            other.hdr = nullptr;
+        }
+
+        shm_ring & operator= (shm_ring && other) noexcept
+        {
+            if (this != &other) {
+                release ();
+                name   = std::move (other.name);
+                owner  = other.owner;
+                fd     = std::move (other.fd);
+                length = other.length;
+                hdr    = other.hdr;
+                mask   = other.mask;
+                head   = other.head;
+                tail   = other.tail;
+
+                other.owner = false;
+                other.hdr = nullptr;
+            }
+            return *this;
+        }
+
+        ~shm_ring (void) noexcept
+        {
+            release ();
+        }
+
+        void push (void const* value) noexcept
+        {
+            while (tail - head > mask) {
+                head = hdr->head.load (std::memory_order_acquire);
+                if (tail - head > mask)
+                    wait (hdr->head, head, hdr->producer_waiting,
+                          hdr->space_event);
+            }
+
+            std::memcpy (slot (tail), value, hdr->elem_size);
+            ++tail;
+            signal (hdr->tail, tail, hdr->consumer_waiting, hdr->data_event,
+                    true);
+        }
+
+        // returns false once the producer has closed (or aborted) the
+        // ring and every value has been consumed.
+        //
+        bool pop (void * value) noexcept
+        {
+            while (head == tail) {
+                tail = hdr->tail.load (std::memory_order_acquire);
+                if (head != tail)
+                    break;
+
+                if (hdr->closed.load (std::memory_order_acquire)) {
+                    tail = hdr->tail.load (std::memory_order_acquire);
+                    if (head == tail)
+                        return false;
+                    break;
+                }
+
+                wait (hdr->tail, tail, hdr->consumer_waiting, hdr->data_event);
+            }
+
+            std::memcpy (value, slot (head), hdr->elem_size);
+            ++head;
+            // a producer blocked on a full ring is only woken once half of
+            // it has drained, rather than being bounced awake per value
+            signal (hdr->head, head, hdr->producer_waiting, hdr->space_event,
+                    tail - head <= mask / 2);
+            return true;
+        }
+
+        void close (bool aborted = false) noexcept
+        {
+            hdr->closed.store (aborted ? 2 : 1, std::memory_order_release);
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            hdr->data_event.fetch_add (1, std::memory_order_release);
+            futex_wake (&hdr->data_event);
+        }
+
+        // whether the producer went away without closing the ring
+        //
+        bool aborted (void) const noexcept
+        {
+            return hdr->closed.load (std::memory_order_acquire) == 2;
+        }
+
+    private:
+        void release (void) noexcept
+        {
+            if (hdr)
+                ::munmap (hdr, length);
+            if (owner)
+                ::shm_unlink (name.c_str ());
+        }
+
+        unsigned char * slot (std::uint32_t pos) const noexcept
+        {
+            return hdr->data + static_cast<std::size_t> (pos & mask) *
+                hdr->elem_size;
+        }
+
+        // publish a new position and wake the other side if it sleeps
+        //
+        static void signal (std::atomic<std::uint32_t> & pos,
+                            std::uint32_t value,
+                            std::atomic<std::uint32_t> & waiting,
+                            std::atomic<std::uint32_t> & event,
+                            bool wake) noexcept
+        {
+            pos.store (value, std::memory_order_release);
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            if (wake && waiting.load (std::memory_order_relaxed)) {
+                event.fetch_add (1, std::memory_order_release);
+                futex_wake (&event);
+            }
+        }
+
+        // wait for the other side to move pos away from seen; the event
+        // counter is sampled before the final check, so a wake-up sent
+        // in between makes the futex wait return at once.
+        //
+        void wait (std::atomic<std::uint32_t> & pos,
+                   std::uint32_t seen,
+                   std::atomic<std::uint32_t> & waiting,
+                   std::atomic<std::uint32_t> & event) noexcept
+        {
+            for (int i = 0; i < 128; ++i) {
+                if (pos.load (std::memory_order_acquire) != seen)
+                    return;
+                cpu_relax ();
+            }
+
+            // give a peer sharing this core the chance to make progress
+            // before paying for a sleep and a wake-up
+            for (int i = 0; i < 4; ++i) {
+                ::sched_yield ();
+                if (pos.load (std::memory_order_acquire) != seen)
+                    return;
+            }
+
+            waiting.store (1, std::memory_order_relaxed);
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+
+            auto const ev = event.load (std::memory_order_acquire);
+            if (pos.load (std::memory_order_acquire) == seen &&
+                not hdr->closed.load (std::memory_order_acquire))
+                futex_wait (&event, ev);
+
+            waiting.store (0, std::memory_order_relaxed);
+        }
+
+        std::string name;
+        bool owner;
+        fd_handle fd;
+        std::size_t length;
+        shm_ring_header * hdr;
+        std::uint32_t mask;
+
+        // positions cached locally; only one of each is ever written
+        std::uint32_t head;
+        std::uint32_t tail;
+    };
+} // namespace detail
+
+    // remove a named ring left behind by a pipeline that did not
+    // shut down cleanly.
+    //
+    inline void shm_remove (std::string const& name) noexcept
+    {
+        ::shm_unlink (name.c_str ());
+    }
+
+
+    // the producing end of a ring; values pushed become visible to
+    // the shm_source of the same name.
+    //
+    template <typename T>
+    class shm_writer
+    {
+        static_assert (std::is_trivially_copyable<T>::value,
+            "values sent through shared memory must be trivially copyable");
+    public:
+        explicit shm_writer (std::string const& name,
+                             std::size_t capacity = 1 << 16)
+            : ring (name, capacity, sizeof (T), false), closed (false)
+        {}
+
+        shm_writer (shm_writer && other) noexcept
+            : ring (std::move (other.ring)), closed (other.closed)
+        {
+            other.closed = true;
+        }
+
+        shm_writer & operator= (shm_writer && other) noexcept
+        {
+            if (this != &other) {
+                if (not closed)
+                    ring.close (true);
+                ring = std::move (other.ring);
+                closed = other.closed;
+                other.closed = true;
+            }
+            return *this;
+        }
+
+        // a writer that was never closed (e.g. unwinding from an
+        // exception) marks the stream aborted, not complete
+        //
+        ~shm_writer (void) noexcept
+        {
+            if (not closed)
+                ring.close (true);
+        }
+
+        void operator() (T const& value) noexcept
+        {
+            ring.push (&value);
+        }
+
+        // signal the end of the stream to the consumer
+        //
+        void close (void) noexcept
+        {
+            if (not closed) {
+                closed = true;
+                ring.close ();
+            }
+        }
+
+    private:
+        detail::shm_ring ring;
+        bool closed;
+    };
+
+
+    // drain a bounded generator into the named ring, then close it;
+    // returns the number of values sent. (For an infinite generator
+    // use e.g. shm_sink (name, bound (g, n)).)
+    //
+    template <typename T>
+    std::uint64_t shm_sink (std::string const& name,
+                            algebraic_generator<T, bot_t> const& g,
+                            std::size_t capacity = 1 << 16)
+    {
+        shm_writer<T> w (name, capacity);
+
+        std::uint64_t n = 0;
+        for (;; ++n) {
+            auto const v = g ();
+            if (is_bot (v))
+                break;
+            w (v.template value<T> ());
+        }
+
+        w.close ();
+        return n;
+    }
+
+
+    // values arriving through the named ring, reverting to bot once
+    // the producer has closed it; throws std::runtime_error at the end
+    // of the values if the producer aborted instead.
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t> shm_source (std::string const& name,
+                                              std::size_t capacity = 1 << 16)
+    {
+        static_assert (std::is_trivially_copyable<T>::value,
+            "values sent through shared memory must be trivially copyable");
+
+        using A = algebraic::algebraic<T, bot_t>;
+
+        auto const ring = std::make_shared<detail::shm_ring>
+            (name, capacity, sizeof (T), true);
+
+        return algebraic_generator<T, bot_t>
+            ([ring,name] (void) -> A
+            {
+                typename std::aligned_storage
+                    <sizeof (T), alignof (T)>::type buf;
+
+                if (not ring->pop (&buf)) {
+                    if (ring->aborted ())
+                        throw std::runtime_error
+                            ("gcomb: shm ring " + name + " aborted by its producer");
+                    return A (bot_t{});
+                }
+
+                return A (*reinterpret_cast<T *> (&buf));
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_SHM_HPP
@@ -0,0 +1,485 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// sketch : mergeable summaries of streams in bounded memory.
+//
+//      // distinct users, ~0.8% error in 16 KiB
+//      auto users = gcomb::sketch (ids, gcomb::hyperloglog<std::uint64_t> (14));
+//      users.estimate ();
+//
+//      // several at once
+//      auto r = gcomb::broadcast (latencies,
+//                                 gcomb::kll<double> (200),
+//                                 gcomb::count_min<double> (2048, 5));
+//      std::get<0> (r).quantile (0.99);
+//
+//      // one per shard, combined afterwards
+//      shard_sketch[0].merge (shard_sketch[1]);
+//
+// note:
+//      Each sketch is a sink (a callable taking T const&, see
+//      broadcast.hpp) with a batch (view) member that updates from a
+//      whole batch at once and a merge member that folds in a sketch of
+//      the same shape built over another part of the stream; merging is
+//      exact, i.e. the result is what one sketch over both parts would
+//      hold (for kll, up to its random compaction).
+//
+//      hyperloglog (p) keeps 2^p one-byte registers; the relative error
+//      of estimate () is about 1.04 / sqrt (2^p). Small counts use linear
+//      counting. Merging takes the register-wise maximum, 16 registers
+//      per SSE2 instruction.
+//
+//      count_min (width, depth) keeps depth rows of width counters
+//      (width rounded up to a power of two). estimate (x) never
+//      undercounts, and overcounts by more than e / width of the total
+//      with probability at most exp (-depth). Row indices come from one
+//      64-bit hash by double hashing. A batch is hashed once and then
+//      applied one row at a time, so each pass touches a single row.
+//
+//      kll (k) is the KLL quantile sketch (Karnin, Lang and Liberty,
+//      "Optimal quantile approximation in streams", 2016) over any T
+//      ordered by Compare: a stack of compactors, each holding values
+//      of weight 2^level; a full compactor is sorted and every other
+//      value (from a random offset) is promoted. The rank error is about
+//      1.7 / k of the count, in O(k) values. A batch is appended to the
+//      lowest compactor before compacting.
+//
+//      Hashes are std::hash (or the given Hash) passed through a 64-bit
+//      finaliser, since std::hash is often the identity.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_SKETCH_HPP
+#define GCOMB_SKETCH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "random.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    // murmur3's 64-bit finaliser
+    //
+    inline std::uint64_t sketch_mix (std::uint64_t h) noexcept
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+
+    inline int leading_zeros (std::uint64_t x) noexcept
+    {
+    #if defined(__GNUC__)
+        return x ? __builtin_clzll (x) : 64;
+    #else
+        int n = 0;
+        for (auto bit = std::uint64_t (1) << 63; bit && not (x & bit); bit >>= 1)
+            ++n;
+        return n;
+    #endif
+    }
+
+
+    // hashes of a batch are computed this many at a time
+    //
+    constexpr std::size_t sketch_block = 256;
+} // namespace detail
+
+    // distinct count estimate
+    //
+    template <typename T, typename Hash = std::hash<T>>
+    class hyperloglog
+    {
+    public:
+        explicit hyperloglog (unsigned p = 14, Hash hash = Hash ())
+            : p (p), regs (std::size_t (1) << (p < 4 || p > 18 ? 4 : p)), hash (hash)
+        {
+            if (p < 4 || p > 18)
+                throw std::invalid_argument ("gcomb: hyperloglog precision must be in [4, 18]");
+        }
+
+        void operator() (T const& value)
+        {
+            add (detail::sketch_mix (hash (value)));
+        }
+
+        void batch (view<T> const& values)
+        {
+            std::uint64_t h[detail::sketch_block];
+
+            for (std::size_t i = 0; i < values.size (); i += detail::sketch_block) {
+                auto const n = std::min (detail::sketch_block, values.size () - i);
+                for (std::size_t j = 0; j < n; ++j)
+                    h[j] = detail::sketch_mix (hash (values[i + j]));
+                for (std::size_t j = 0; j < n; ++j)
+                    add (h[j]);
+            }
+        }
+
+        void merge (hyperloglog const& other)
+        {
+            if (other.p != p)
+                throw std::invalid_argument ("gcomb: merge of hyperloglogs of different precision");
+
+            std::size_t i = 0;
+        #if defined(__SSE2__)
+            for (; i + 16 <= regs.size (); i += 16) {
+                auto * a = reinterpret_cast<__m128i *> (regs.data () + i);
+                auto const b = _mm_loadu_si128 (reinterpret_cast<__m128i const*> (other.regs.data () + i));
+                _mm_storeu_si128 (a, _mm_max_epu8 (_mm_loadu_si128 (a), b));
+            }
+        #endif
+            for (; i < regs.size (); ++i)
+                regs[i] = std::max (regs[i], other.regs[i]);
+        }
+
+        double estimate (void) const
+        {
+            auto const m = static_cast<double> (regs.size ());
+
+            double sum = 0;
+            std::size_t zeros = 0;
+            for (auto r : regs) {
+                sum += std::ldexp (1.0, -static_cast<int> (r));
+                zeros += r == 0;
+            }
+
+            double const alpha = regs.size () == 16 ? 0.673
+                               : regs.size () == 32 ? 0.697
+                               : regs.size () == 64 ? 0.709
+                               : 0.7213 / (1.0 + 1.079 / m);
+
+            auto const e = alpha * m * m / sum;
+            if (e <= 2.5 * m && zeros)
+                return m * std::log (m / static_cast<double> (zeros));
+            return e;
+        }
+
+        unsigned precision (void) const noexcept
+        {
+            return p;
+        }
+
+    private:
+        void add (std::uint64_t h) noexcept
+        {
+            auto const idx = h >> (64 - p);
+            auto const rank = static_cast<std::uint8_t>
+                (std::min (detail::leading_zeros (h << p), 64 - static_cast<int> (p)) + 1);
+            if (regs[idx] < rank)
+                regs[idx] = rank;
+        }
+
+        unsigned p;
+        std::vector<std::uint8_t> regs;
+        Hash hash;
+    };
+
+
+    // frequency estimates
+    //
+    template <typename T, typename Hash = std::hash<T>>
+    class count_min
+    {
+    public:
+        count_min (std::size_t width, std::size_t depth,
+                   std::uint64_t seed = 0, Hash hash = Hash ())
+            : width (1), depth (depth ? depth : 1), seed (seed), total_ (0), hash (hash)
+        {
+            while (this->width < width)
+                this->width <<= 1;
+            table.assign (this->width * this->depth, 0);
+        }
+
+        void operator() (T const& value, std::uint64_t count = 1)
+        {
+            auto const h = hash_of (value);
+            for (std::size_t r = 0; r < depth; ++r)
+                table[r * width + index (h, r)] += count;
+            total_ += count;
+        }
+
+        void batch (view<T> const& values)
+        {
+            std::uint64_t h[detail::sketch_block];
+
+            for (std::size_t i = 0; i < values.size (); i += detail::sketch_block) {
+                auto const n = std::min (detail::sketch_block, values.size () - i);
+                for (std::size_t j = 0; j < n; ++j)
+                    h[j] = hash_of (values[i + j]);
+
+                for (std::size_t r = 0; r < depth; ++r) {
+                    auto * row = table.data () + r * width;
+                    for (std::size_t j = 0; j < n; ++j)
+                        ++row[index (h[j], r)];
+                }
+            }
+            total_ += values.size ();
+        }
+
+        void merge (count_min const& other)
+        {
+            if (other.width != width || other.depth != depth || other.seed != seed)
+                throw std::invalid_argument ("gcomb: merge of count_min sketches of different shape");
+
+            for (std::size_t i = 0; i < table.size (); ++i)
+                table[i] += other.table[i];
+            total_ += other.total_;
+        }
+
+        // an upper bound on the number of times value was seen
+        //
+        std::uint64_t estimate (T const& value) const
+        {
+            auto const h = hash_of (value);
+            auto best = table[index (h, 0)];
+            for (std::size_t r = 1; r < depth; ++r)
+                best = std::min (best, table[r * width + index (h, r)]);
+            return best;
+        }
+
+        std::uint64_t total (void) const noexcept
+        {
+            return total_;
+        }
+
+    private:
+        std::uint64_t hash_of (T const& value) const
+        {
+            return detail::sketch_mix (hash (value) ^ seed);
+        }
+
+        // row r's column: h1 + r h2, with h2 odd
+        //
+        std::size_t index (std::uint64_t h, std::size_t r) const noexcept
+        {
+            auto const h2 = ((h >> 32) | (h << 32)) | 1;
+            return static_cast<std::size_t> (h + r * h2) & (width - 1);
+        }
+
+        std::size_t width;
+        std::size_t depth;
+        std::uint64_t seed;
+        std::uint64_t total_;
+        std::vector<std::uint64_t> table;   // depth rows of width
+        Hash hash;
+    };
+
+
+    // quantile estimates (KLL)
+    //
+    template <typename T, typename Compare = std::less<T>>
+    class kll
+    {
+    public:
+        explicit kll (std::size_t k = 200, std::uint64_t seed = 0, Compare cmp = Compare ())
+            : k (std::max<std::size_t> (k, 8)), n (0), size (0),
+              rng (seed), coins (0), cmp (cmp)
+        {
+            grow ();
+        }
+
+        void operator() (T const& value)
+        {
+            levels[0].push_back (value);
+            ++n;
+            if (++size >= limit)
+                compress ();
+        }
+
+        void batch (view<T> const& values)
+        {
+            levels[0].insert (levels[0].end (), values.begin (), values.end ());
+            n += values.size ();
+            size += values.size ();
+            while (size >= limit)
+                compress ();
+        }
+
+        void merge (kll const& other)
+        {
+            while (levels.size () < other.levels.size ())
+                grow ();
+
+            for (std::size_t h = 0; h < other.levels.size (); ++h)
+                levels[h].insert (levels[h].end (),
+                                  other.levels[h].begin (), other.levels[h].end ());
+
+            n += other.n;
+            size += other.size;
+            while (size >= limit)
+                compress ();
+        }
+
+        // values seen
+        //
+        std::uint64_t count (void) const noexcept
+        {
+            return n;
+        }
+
+        // a value with about q n values below it, q in [0, 1]; the
+        // sketch must not be empty
+        //
+        T quantile (double q) const
+        {
+            if (n == 0)
+                throw std::out_of_range ("gcomb: quantile of an empty kll sketch");
+
+            auto const items = weighted ();
+            auto const target = q * static_cast<double> (n);
+
+            std::uint64_t below = 0;
+            for (auto const& it : items) {
+                below += it.second;
+                if (static_cast<double> (below) > target)
+                    return it.first;
+            }
+            return items.back ().first;
+        }
+
+        // the estimated fraction of values not above value
+        //
+        double rank (T const& value) const
+        {
+            if (n == 0)
+                return 0.0;
+
+            std::uint64_t below = 0;
+            for (std::size_t h = 0; h < levels.size (); ++h)
+                for (auto const& x : levels[h])
+                    if (not cmp (value, x))
+                        below += std::uint64_t (1) << h;
+            return static_cast<double> (below) / static_cast<double> (n);
+        }
+
+    private:
+        // the capacity of level h is k (2/3)^(levels - 1 - h), at least 2
+        //
+        void grow (void)
+        {
+            levels.emplace_back ();
+            caps.resize (levels.size ());
+
+            limit = 0;
+            for (std::size_t h = 0; h < levels.size (); ++h) {
+                auto const depth = static_cast<double> (levels.size () - 1 - h);
+                auto const c = static_cast<double> (k) * std::pow (2.0 / 3.0, depth);
+                caps[h] = std::max<std::size_t> (2, static_cast<std::size_t> (std::ceil (c)));
+                limit += caps[h];
+            }
+        }
+
+        bool coin (void) noexcept
+        {
+            return rng.at (coins++, uniform_bits<std::uint32_t> {}) & 1;
+        }
+
+        // compact the lowest level over capacity into the next
+        //
+        void compress (void)
+        {
+            for (std::size_t h = 0; h < levels.size (); ++h) {
+                if (levels[h].size () < caps[h])
+                    continue;
+
+                if (h + 1 == levels.size ())
+                    grow ();
+
+                auto & cur = levels[h];
+                auto & up  = levels[h + 1];
+                std::sort (cur.begin (), cur.end (), cmp);
+
+                // an odd value out stays behind
+                auto const keep = cur.size () % 2;
+                auto const pairs = cur.size () - keep;
+
+                for (auto i = keep + (coin () ? 1 : 0); i < cur.size (); i += 2)
+                    up.push_back (cur[i]);
+
+                cur.erase (cur.begin () + keep, cur.end ());
+                size -= pairs / 2;
+                return;
+            }
+        }
+
+        std::vector<std::pair<T, std::uint64_t>> weighted (void) const
+        {
+            std::vector<std::pair<T, std::uint64_t>> items;
+            items.reserve (size);
+            for (std::size_t h = 0; h < levels.size (); ++h)
+                for (auto const& x : levels[h])
+                    items.emplace_back (x, std::uint64_t (1) << h);
+
+            auto const c = cmp;
+            std::sort (items.begin (), items.end (),
+                [c] (std::pair<T, std::uint64_t> const& a, std::pair<T, std::uint64_t> const& b)
+                {
+                    return c (a.first, b.first);
+                });
+            return items;
+        }
+
+        std::size_t k;
+        std::uint64_t n;
+        std::size_t size;       // values held, over all levels
+        std::size_t limit;      // total capacity
+        std::vector<std::vector<T>> levels;
+        std::vector<std::size_t> caps;
+        philox rng;
+        std::uint64_t coins;
+        Compare cmp;
+    };
+
+    // feed every value of a bounded generator to a sketch; returns it
+    //
+    template <typename T, typename Sketch>
+    Sketch sketch (algebraic_generator<T, bot_t> const& g, Sketch s)
+    {
+        for (;;) {
+            auto const v = g ();
+            if (is_bot (v))
+                return s;
+            s (v.template value<T> ());
+        }
+    }
+
+
+    // feed a stream of batches to a sketch through its batch update
+    //
+    template <typename T, typename Sketch>
+    Sketch sketch (algebraic_generator<view<T>, bot_t> const& batches, Sketch s)
+    {
+        for (;;) {
+            auto const v = batches ();
+            if (is_bot (v))
+                return s;
+            s.batch (v.template value<view<T>> ());
+        }
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_SKETCH_HPP
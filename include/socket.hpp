@@ -0,0 +1,446 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// socket : moving trivially copyable values over local stream
+//          sockets (Unix domain, or TCP on the loopback interface).
+//
+//      server:  auto g = gcomb::socket_source<T>
+//                   (gcomb::socket_accept (gcomb::unix_listen ("/tmp/s")));
+//      client:  gcomb::socket_sink (gcomb::unix_connect ("/tmp/s"), g);
+//
+// note:
+//      Values are sent in frames: a 32-bit count followed by that many
+//      values, written with a single sendmsg gathering header and
+//      payload. Only a frame with a count of zero ends the stream; it is
+//      sent by an explicit close, never by a writer's destructor, so a
+//      sender that failed (or was destroyed before closing) leaves the
+//      connection to end without one, and the source throws rather than
+//      reporting a complete stream. The receiver reads with readv
+//      into both free regions of a large ring buffer at once, so each
+//      system call typically delivers many frames.
+//
+//      Both ends enlarge the kernel socket buffers. The functions
+//      taking a descriptor take ownership of it.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_SOCKET_HPP
+#define GCOMB_SOCKET_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    constexpr int socket_buffer_bytes = 4 << 20;
+
+    inline void tune_socket (int fd) noexcept
+    {
+        int sz = socket_buffer_bytes;
+        ::setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof sz);
+        ::setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof sz);
+    }
+
+
+    inline sockaddr_un unix_address (std::string const& path)
+    {
+        sockaddr_un addr;
+        std::memset (&addr, 0, sizeof addr);
+        addr.sun_family = AF_UNIX;
+
+        if (path.size () >= sizeof addr.sun_path)
+            throw std::invalid_argument ("gcomb: socket path too long: " + path);
+        std::memcpy (addr.sun_path, path.c_str (), path.size () + 1);
+
+        return addr;
+    }
+
+
+    inline sockaddr_in loopback_address (std::uint16_t port) noexcept
+    {
+        sockaddr_in addr;
+        std::memset (&addr, 0, sizeof addr);
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons (port);
+        addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        return addr;
+    }
+
+
+    inline int make_socket (int domain)
+    {
+        int const fd = ::socket (domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            throw_errno ("socket");
+        tune_socket (fd);
+        return fd;
+    }
+
+
+    // send every byte of the given buffers
+    //
+    inline void send_all (int fd, iovec * iov, int iovcnt)
+    {
+        while (iovcnt) {
+            msghdr msg;
+            std::memset (&msg, 0, sizeof msg);
+            msg.msg_iov    = iov;
+            msg.msg_iovlen = static_cast<std::size_t> (iovcnt);
+
+            auto n = ::sendmsg (fd, &msg, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw_errno ("sendmsg");
+            }
+
+            while (iovcnt && static_cast<std::size_t> (n) >= iov->iov_len) {
+                n -= static_cast<ssize_t> (iov->iov_len);
+                ++iov;
+                --iovcnt;
+            }
+            if (iovcnt) {
+                iov->iov_base = static_cast<char *> (iov->iov_base) + n;
+                iov->iov_len -= static_cast<std::size_t> (n);
+            }
+        }
+    }
+
+
+    // receive side ring buffer, filled by readv into its (up to two)
+    // free regions.
+    //
+    class socket_ring
+    {
+    public:
+        socket_ring (int fd, std::size_t capacity)
+            : fd (fd), buf (capacity), rd (0), wr (0), eof (false)
+        {}
+
+        std::size_t available (void) const noexcept
+        {
+            return static_cast<std::size_t> (wr - rd);
+        }
+
+        // make at least n bytes available; false if the peer closed first
+        //
+        bool want (std::size_t n)
+        {
+            while (available () < n) {
+                if (eof)
+                    return false;
+                fill ();
+            }
+            return true;
+        }
+
+        void take (void * dst, std::size_t n) noexcept
+        {
+            auto const cap = buf.size ();
+            auto const at  = static_cast<std::size_t> (rd % cap);
+            auto const first = std::min (n, cap - at);
+
+            std::memcpy (dst, buf.data () + at, first);
+            std::memcpy (static_cast<char *> (dst) + first, buf.data (), n - first);
+            rd += n;
+        }
+
+    private:
+        void fill (void)
+        {
+            auto const cap  = buf.size ();
+            auto const free = cap - available ();
+            auto const at   = static_cast<std::size_t> (wr % cap);
+            auto const first = std::min (free, cap - at);
+
+            iovec iov[2] = {
+                {buf.data () + at, first},
+                {buf.data (), free - first}
+            };
+
+            for (;;) {
+                auto const n = ::readv (fd.fd, iov, iov[1].iov_len ? 2 : 1);
+                if (n > 0) {
+                    wr += static_cast<std::uint64_t> (n);
+                    return;
+                }
+                if (n == 0) {
+                    eof = true;
+                    return;
+                }
+                if (errno != EINTR)
+                    throw_errno ("readv");
+            }
+        }
+
+        fd_handle fd;
+        std::vector<char> buf;
+        std::uint64_t rd;
+        std::uint64_t wr;
+        bool eof;
+    };
+} // namespace detail
+
+    // listen on a Unix domain socket at path (replacing a stale socket;
+    // any other file there makes the bind fail)
+    //
+    inline int unix_listen (std::string const& path, int backlog = 16)
+    {
+        auto const addr = detail::unix_address (path);
+        detail::fd_handle fd (detail::make_socket (AF_UNIX));
+
+        struct stat st;
+        if (::lstat (path.c_str (), &st) == 0 && S_ISSOCK (st.st_mode))
+            ::unlink (path.c_str ());
+        if (::bind (fd.fd, reinterpret_cast<sockaddr const*> (&addr), sizeof addr) != 0)
+            detail::throw_errno ("bind " + path);
+        if (::listen (fd.fd, backlog) != 0)
+            detail::throw_errno ("listen " + path);
+
+        auto const r = fd.fd;
+        fd.fd = -1;
+        return r;
+    }
+
+
+    inline int unix_connect (std::string const& path)
+    {
+        auto const addr = detail::unix_address (path);
+        detail::fd_handle fd (detail::make_socket (AF_UNIX));
+
+        if (::connect (fd.fd, reinterpret_cast<sockaddr const*> (&addr), sizeof addr) != 0)
+            detail::throw_errno ("connect " + path);
+
+        auto const r = fd.fd;
+        fd.fd = -1;
+        return r;
+    }
+
+
+    // listen on 127.0.0.1:port
+    //
+    inline int tcp_listen (std::uint16_t port, int backlog = 16)
+    {
+        auto const addr = detail::loopback_address (port);
+        detail::fd_handle fd (detail::make_socket (AF_INET));
+
+        int one = 1;
+        ::setsockopt (fd.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+        if (::bind (fd.fd, reinterpret_cast<sockaddr const*> (&addr), sizeof addr) != 0)
+            detail::throw_errno ("bind");
+        if (::listen (fd.fd, backlog) != 0)
+            detail::throw_errno ("listen");
+
+        auto const r = fd.fd;
+        fd.fd = -1;
+        return r;
+    }
+
+
+    inline int tcp_connect (std::uint16_t port)
+    {
+        auto const addr = detail::loopback_address (port);
+        detail::fd_handle fd (detail::make_socket (AF_INET));
+
+        // frames are already batched; do not let Nagle delay them
+        int one = 1;
+        ::setsockopt (fd.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+        if (::connect (fd.fd, reinterpret_cast<sockaddr const*> (&addr), sizeof addr) != 0)
+            detail::throw_errno ("connect");
+
+        auto const r = fd.fd;
+        fd.fd = -1;
+        return r;
+    }
+
+
+    // accept one connection on a listening socket (which is left open)
+    //
+    inline int socket_accept (int listener)
+    {
+        for (;;) {
+            int const fd = ::accept4 (listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                detail::tune_socket (fd);
+                return fd;
+            }
+            if (errno != EINTR)
+                detail::throw_errno ("accept");
+        }
+    }
+
+
+    // the sending end of a framed stream of T
+    //
+    template <typename T>
+    class socket_writer
+    {
+        static_assert (std::is_trivially_copyable<T>::value,
+            "values sent over a socket must be trivially copyable");
+    public:
+        explicit socket_writer (int fd, std::size_t batch = 4096)
+            : fd (fd), closed (false)
+        {
+            buf.reserve (batch ? batch : 1);
+        }
+
+        socket_writer (socket_writer &&) = default;
+        socket_writer & operator= (socket_writer &&) = default;
+
+        // closing the descriptor without an end frame tells the reader
+        // the stream did not complete
+        //
+        ~socket_writer (void) noexcept = default;
+
+        void operator() (T const& value)
+        {
+            buf.push_back (value);
+            if (buf.size () == buf.capacity ())
+                flush ();
+        }
+
+        // send whatever is buffered as one frame
+        //
+        void flush (void)
+        {
+            if (buf.empty ())
+                return;
+            send_frame (buf.data (), buf.size ());
+            buf.clear ();
+        }
+
+        // flush, send the end-of-stream frame and shut down writing
+        //
+        void close (void)
+        {
+            if (closed)
+                return;
+            closed = true;
+
+            flush ();
+            send_frame (nullptr, 0);
+            ::shutdown (fd.fd, SHUT_WR);
+        }
+
+    private:
+        void send_frame (T const* values, std::size_t n)
+        {
+            auto count = static_cast<std::uint32_t> (n);
+            iovec iov[2] = {
+                {&count, sizeof count},
+                {const_cast<T *> (values), n * sizeof (T)}
+            };
+            detail::send_all (fd.fd, iov, n ? 2 : 1);
+        }
+
+        detail::fd_handle fd;
+        std::vector<T> buf;
+        bool closed;
+    };
+
+
+    // drain a bounded generator over a connected socket, batch values
+    // per frame; returns the number of values sent.
+    //
+    template <typename T>
+    std::uint64_t socket_sink (int fd, algebraic_generator<T, bot_t> const& g,
+                               std::size_t batch = 4096)
+    {
+        socket_writer<T> w (fd, batch);
+
+        std::uint64_t n = 0;
+        for (;; ++n) {
+            auto const v = g ();
+            if (is_bot (v))
+                break;
+            w (v.template value<T> ());
+        }
+
+        w.close ();
+        return n;
+    }
+
+
+    // values arriving over a connected socket, reverting to bot at the
+    // end frame; throws std::runtime_error if the connection ends
+    // without one.
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t> socket_source (int fd,
+                                                 std::size_t buffer = 4 << 20)
+    {
+        static_assert (std::is_trivially_copyable<T>::value,
+            "values sent over a socket must be trivially copyable");
+
+        using A = algebraic::algebraic<T, bot_t>;
+
+        struct state
+        {
+            detail::socket_ring ring;
+            std::uint32_t left;
+            bool done;
+        };
+
+        auto const st = std::shared_ptr<state>
+            (new state {{fd, std::max<std::size_t> (buffer, 2 * sizeof (T) + 8)}, 0, false});
+
+        return algebraic_generator<T, bot_t>
+            ([st] (void) -> A
+            {
+                while (st->left == 0) {
+                    if (st->done)
+                        return A (bot_t{});
+
+                    if (not st->ring.want (sizeof (std::uint32_t))) {
+                        if (st->ring.available ())
+                            throw std::runtime_error ("gcomb: truncated frame");
+                        throw std::runtime_error
+                            ("gcomb: socket stream ended without an end frame");
+                    }
+
+                    st->ring.take (&st->left, sizeof st->left);
+                    if (st->left == 0)
+                        st->done = true;
+                }
+
+                if (not st->ring.want (sizeof (T)))
+                    throw std::runtime_error ("gcomb: truncated frame");
+
+                typename std::aligned_storage
+                    <sizeof (T), alignof (T)>::type buf;
+                st->ring.take (&buf, sizeof (T));
+                --st->left;
+
+                return A (*reinterpret_cast<T *> (&buf));
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_SOCKET_HPP
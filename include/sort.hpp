@@ -0,0 +1,339 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// sort : sorting bounded streams that may not fit in memory.
+//
+//      auto sorted = gcomb::sort_external (records, by_key {},
+//                                          std::size_t (48) << 30,
+//                                          "/scratch");
+//
+// note:
+//      sort_external drains the input into a buffer of memory_budget
+//      bytes. Each time the buffer fills it is cut into one slice per
+//      thread, the slices are sorted concurrently, and every sorted
+//      slice is appended to a temporary file as a run. The returned
+//      generator then merges all runs with a loser tree (merge.hpp),
+//      reading each through a buffer of its share of the budget.
+//
+//      Sorted slices are kept as separate runs rather than merged in
+//      memory: the final merge has to happen anyway, and merging more
+//      runs costs one more comparison per value only when the run count
+//      doubles. If the whole input fits in a single buffer nothing is
+//      written to disk and the sorted slices are merged in memory.
+//
+//      Each run being merged gets a read buffer of at least 64 KiB; when
+//      the budget cannot cover that for every run, groups of runs are
+//      first merged into longer runs in a new spill file (a multi-pass
+//      merge), until it can.
+//
+//      Spill files are created unlinked (O_TMPFILE where supported) in
+//      tmpdir, so they disappear with the generator, or with the
+//      process, whichever goes first.
+//
+//      Values are spilled as raw bytes, so T must be trivially copyable.
+//      The sort is not stable.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_SORT_HPP
+#define GCOMB_SORT_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "merge.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    // an anonymous read/write file in dir
+    //
+    inline int unlinked_temp_file (std::string const& dir)
+    {
+    #ifdef O_TMPFILE
+        int const fd = ::open (dir.c_str (), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (fd >= 0)
+            return fd;
+        if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+            throw_errno ("open " + dir);
+    #endif
+
+        std::string path = dir + "/gcomb-sort-XXXXXX";
+        int const tmp = ::mkostemp (&path[0], O_CLOEXEC);
+        if (tmp < 0)
+            throw_errno ("mkstemp " + path);
+        ::unlink (path.c_str ());
+        return tmp;
+    }
+
+
+    inline std::size_t pread_full (int fd, char * buf, std::size_t n, std::uint64_t offset)
+    {
+        std::size_t done = 0;
+        while (done < n) {
+            auto const r = ::pread (fd, buf + done, n - done,
+                                    static_cast<off_t> (offset + done));
+            if (r > 0)
+                done += static_cast<std::size_t> (r);
+            else if (r == 0)
+                break;
+            else if (errno != EINTR)
+                throw_errno ("pread");
+        }
+        return done;
+    }
+
+
+    struct sort_run
+    {
+        std::uint64_t offset;   // in values
+        std::uint64_t count;
+    };
+
+
+    // the values of one spilled run, read through a buffer
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t> read_run (std::shared_ptr<fd_handle> file,
+                                            sort_run run, std::size_t buffer)
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        struct state
+        {
+            std::shared_ptr<fd_handle> file;
+            sort_run run;
+            std::vector<T> buf;
+            std::size_t pos;
+            std::size_t len;
+        };
+
+        auto const st = std::shared_ptr<state>
+            (new state {std::move (file), run, std::vector<T> (buffer), 0, 0});
+
+        return algebraic_generator<T, bot_t>
+            ([st] (void) -> A
+            {
+                if (st->pos == st->len) {
+                    if (st->run.count == 0)
+                        return A (bot_t{});
+
+                    auto const n = static_cast<std::size_t>
+                        (std::min<std::uint64_t> (st->run.count, st->buf.size ()));
+                    auto const bytes = n * sizeof (T);
+
+                    if (pread_full (st->file->fd, reinterpret_cast<char *> (st->buf.data ()),
+                                    bytes, st->run.offset * sizeof (T)) != bytes)
+                        throw std::runtime_error ("gcomb: sort spill file truncated");
+
+                    st->run.offset += n;
+                    st->run.count  -= n;
+                    st->pos = 0;
+                    st->len = n;
+                }
+
+                return A (st->buf[st->pos++]);
+            });
+    }
+
+
+    // the sorted slice [first, last) of a shared buffer
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t> read_slice (std::shared_ptr<std::vector<T>> buf,
+                                              std::size_t first, std::size_t last)
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        return algebraic_generator<T, bot_t>
+            ([buf,first,last] (void) mutable -> A
+            {
+                if (first == last)
+                    return A (bot_t{});
+                return A ((*buf)[first++]);
+            });
+    }
+
+
+    // sort parts slices of v concurrently; returns the slice bounds
+    //
+    template <typename T, typename Compare>
+    std::vector<std::size_t> sort_slices (std::vector<T> & v, std::size_t parts,
+                                          Compare const& cmp)
+    {
+        constexpr std::size_t min_slice = 1 << 14;
+        parts = std::max<std::size_t> (1, std::min (parts, v.size () / min_slice));
+
+        std::vector<std::size_t> bounds (parts + 1);
+        for (std::size_t i = 0; i <= parts; ++i)
+            bounds[i] = v.size () * i / parts;
+
+        std::vector<std::thread> pool;
+        for (std::size_t i = 1; i < parts; ++i)
+            pool.emplace_back ([&v,&bounds,&cmp,i] (void)
+            {
+                std::sort (v.begin () + bounds[i], v.begin () + bounds[i + 1], cmp);
+            });
+
+        std::sort (v.begin (), v.begin () + bounds[1], cmp);
+        for (auto & t : pool)
+            t.join ();
+
+        return bounds;
+    }
+} // namespace detail
+
+    // sort a bounded generator using at most about memory_budget bytes
+    // of memory, spilling sorted runs to an unlinked file in tmpdir.
+    //
+    template <typename T, typename Compare = std::less<T>>
+    algebraic_generator<T, bot_t>
+        sort_external (algebraic_generator<T, bot_t> const& g,
+                       Compare cmp = Compare (),
+                       std::size_t memory_budget = std::size_t (1) << 30,
+                       std::string const& tmpdir = "/tmp",
+                       unsigned threads = 0)
+    {
+        static_assert (std::is_trivially_copyable<T>::value,
+            "sort_external spills raw values and needs a trivially copyable T");
+
+        if (threads == 0)
+            threads = std::max (1u, std::thread::hardware_concurrency ());
+
+        auto const capacity = std::max<std::size_t> (1, memory_budget / sizeof (T));
+
+        // reserved whole: growing by doubling would hold the old and the
+        // new buffer at once, up to twice the budget; pages of the
+        // reservation left untouched (a short input) are never committed
+        auto buf = std::make_shared<std::vector<T>> ();
+        buf->reserve (capacity);
+
+        std::shared_ptr<detail::fd_handle> file;
+        std::vector<detail::sort_run> runs;
+        std::uint64_t written = 0;
+
+        auto const spill = [&] (void)
+        {
+            if (not file)
+                file = std::make_shared<detail::fd_handle>
+                    (detail::unlinked_temp_file (tmpdir));
+
+            auto const bounds = detail::sort_slices (*buf, threads, cmp);
+            for (std::size_t i = 0; i + 1 < bounds.size (); ++i) {
+                auto const n = bounds[i + 1] - bounds[i];
+                detail::write_full (file->fd,
+                                    reinterpret_cast<char const*> (buf->data () + bounds[i]),
+                                    n * sizeof (T));
+                runs.push_back (detail::sort_run {written, n});
+                written += n;
+            }
+            buf->clear ();
+        };
+
+        for (;;) {
+            auto const v = g ();
+            if (is_bot (v))
+                break;
+
+            buf->push_back (v.template value<T> ());
+            if (buf->size () == capacity)
+                spill ();
+        }
+
+        std::vector<algebraic_generator<T, bot_t>> inputs;
+
+        if (not file) {
+            // everything fit: merge the sorted slices in memory
+            auto const bounds = detail::sort_slices (*buf, threads, cmp);
+            for (std::size_t i = 0; i + 1 < bounds.size (); ++i)
+                inputs.push_back (detail::read_slice (buf, bounds[i], bounds[i + 1]));
+            return merge (inputs, cmp);
+        }
+
+        if (not buf->empty ())
+            spill ();
+        buf.reset ();
+
+        // every run being merged needs a read buffer of at least
+        // min_read values; merge in passes while there are too many
+        auto const min_read = std::max<std::size_t> (1, (64 << 10) / sizeof (T));
+        auto const fan_in   = std::max<std::size_t> (2, capacity / min_read);
+
+        while (runs.size () > fan_in) {
+            auto const next = std::make_shared<detail::fd_handle>
+                (detail::unlinked_temp_file (tmpdir));
+            std::vector<detail::sort_run> merged;
+            std::vector<T> out;
+            out.reserve (min_read);
+            std::uint64_t at = 0;
+
+            for (std::size_t first = 0; first < runs.size (); first += fan_in) {
+                auto const last = std::min (runs.size (), first + fan_in);
+                auto const per_run = std::max<std::size_t> (1, capacity / (last - first + 1));
+
+                std::vector<algebraic_generator<T, bot_t>> group;
+                for (auto i = first; i < last; ++i)
+                    group.push_back (detail::read_run<T> (file, runs[i], per_run));
+
+                auto const m = merge (group, cmp);
+                std::uint64_t n = 0;
+                for (;;) {
+                    auto const v = m ();
+                    bool const end = is_bot (v);
+                    if (not end) {
+                        out.push_back (v.template value<T> ());
+                        ++n;
+                    }
+                    if (out.size () == min_read || (end && not out.empty ())) {
+                        detail::write_full (next->fd, reinterpret_cast<char const*> (out.data ()),
+                                            out.size () * sizeof (T));
+                        out.clear ();
+                    }
+                    if (end)
+                        break;
+                }
+
+                merged.push_back (detail::sort_run {at, n});
+                at += n;
+            }
+
+            file = next;
+            runs.swap (merged);
+        }
+
+    #ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise (file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    #endif
+
+        // share the budget between the runs' read buffers
+        auto const per_run = std::min<std::size_t>
+            (std::max<std::size_t> (1, capacity / runs.size ()),
+             std::max<std::size_t> (1, (8 << 20) / sizeof (T)));
+
+        for (auto const& r : runs)
+            inputs.push_back (detail::read_run<T> (file, r, per_run));
+
+        return merge (inputs, cmp);
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_SORT_HPP
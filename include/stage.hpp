@@ -0,0 +1,156 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// stage : turning a combinator boundary into a bounded queue
+//         served by a thread of its own.
+//
+//      auto parsed = gcomb::stage (gcomb::bind (parse, lines), 4096);
+//      auto scored = gcomb::bind (score, parsed);
+//
+//      Everything upstream of the boundary (here: reading and parsing)
+//      now runs on the stage's thread, at most `capacity` values ahead
+//      of the consumer.
+//
+// note:
+//      The queue is a channel (see channel.hpp). Once it is full the
+//      stage's thread waits, so a fast producer can never run more than
+//      `capacity` values ahead of a slow sink: memory stays bounded and
+//      the slow end of the pipeline sets the pace (backpressure).
+//
+//      An exception thrown upstream is carried across the queue and
+//      rethrown to the consumer when it reaches that point in the stream.
+//
+//      Destroying the last copy of a staged generator closes its queue
+//      and joins the thread; the thread notices at its next push, so an
+//      upstream blocked indefinitely (e.g. on input) delays destruction.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_STAGE_HPP
+#define GCOMB_STAGE_HPP
+
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "algebraic_generator.hpp"
+#include "channel.hpp"
+#include "generator.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    template <typename T>
+    class stage_state
+    {
+    public:
+        stage_state (std::size_t capacity, wait_policy policy)
+            : queue (capacity, policy)
+        {}
+
+        stage_state (stage_state const&) = delete;
+        stage_state & operator= (stage_state const&) = delete;
+
+        ~stage_state (void) noexcept
+        {
+            queue.close ();
+            if (worker.joinable ())
+                worker.join ();
+        }
+
+        // run produce (queue) -> bool on the stage's thread until it
+        // returns false or the queue is closed.
+        //
+        template <typename Produce>
+        void start (Produce produce)
+        {
+            worker = std::thread ([this,produce] (void) mutable
+            {
+                try {
+                    while (produce (queue))
+                        ;
+                } catch (...) {
+                    error = std::current_exception ();
+                }
+                queue.close ();
+            });
+        }
+
+        // the next value; false at the end of the stream, and rethrows
+        // an upstream exception once the values before it are consumed
+        //
+        bool next (T & out)
+        {
+            if (queue.pop (out))
+                return true;
+            if (error)
+                std::rethrow_exception (error);
+            return false;
+        }
+
+    private:
+        channel<T> queue;
+        std::exception_ptr error;   // written before close, read after
+        std::thread worker;
+    };
+} // namespace detail
+
+    // decouple an infinite generator from its consumer through a
+    // bounded queue of the given capacity.
+    //
+    template <typename T>
+    generator<T> stage (generator<T> const& g,
+                        std::size_t capacity = 1024,
+                        wait_policy policy = wait_policy::hybrid)
+    {
+        auto const st = std::make_shared<detail::stage_state<T>> (capacity, policy);
+
+        st->start ([g] (channel<T> & q) { return q.push (g ()); });
+
+        return generator<T>
+            ([st] (void) -> T
+            {
+                T value;
+                if (not st->next (value))
+                    throw std::logic_error ("gcomb: infinite stage ran dry");
+                return value;
+            });
+    }
+
+
+    // decouple a bounded generator from its consumer; the staged
+    // generator reverts to bot after the upstream does.
+    //
+    template <typename T>
+    algebraic_generator<T, bot_t> stage (algebraic_generator<T, bot_t> const& g,
+                                         std::size_t capacity = 1024,
+                                         wait_policy policy = wait_policy::hybrid)
+    {
+        using A = algebraic::algebraic<T, bot_t>;
+
+        auto const st = std::make_shared<detail::stage_state<T>> (capacity, policy);
+
+        st->start ([g] (channel<T> & q)
+        {
+            auto const v = g ();
+            return not is_bot (v) && q.push (v.template value<T> ());
+        });
+
+        return algebraic_generator<T, bot_t>
+            ([st] (void) -> A
+            {
+                T value;
+                if (not st->next (value))
+                    return A (bot_t{});
+                return A (std::move (value));
+            });
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_STAGE_HPP
@@ -0,0 +1,150 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// sync : low level waiting primitives shared by the concurrent
+//        sources and stages (Linux futexes).
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_SYNC_HPP
+#define GCOMB_SYNC_HPP
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace gcomb
+{
+    // how a blocked producer or consumer waits
+    //
+    enum class wait_policy
+    {
+        spin,   // busy wait (with pause/yield); lowest latency, burns a core
+        block,  // sleep in the kernel straight away
+        hybrid  // spin briefly, yield, then sleep
+    };
+
+namespace detail
+{
+    inline void cpu_relax (void) noexcept
+    {
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause ();
+    #elif defined(__aarch64__)
+        asm volatile ("yield" ::: "memory");
+    #endif
+    }
+
+
+    // wait while *addr == expected; shared futexes work across
+    // processes (e.g. in shared memory), private ones are cheaper.
+    //
+    inline void futex_wait (std::atomic<std::uint32_t> * addr,
+                            std::uint32_t expected,
+                            bool shared = true) noexcept
+    {
+        ::syscall (SYS_futex, reinterpret_cast<std::uint32_t *> (addr),
+                   shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,
+                   expected, nullptr, nullptr, 0);
+    }
+
+
+    inline void futex_wake (std::atomic<std::uint32_t> * addr,
+                            int count = 1,
+                            bool shared = true) noexcept
+    {
+        ::syscall (SYS_futex, reinterpret_cast<std::uint32_t *> (addr),
+                   shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+                   count, nullptr, nullptr, 0);
+    }
+
+
+    // an event count: lets threads sleep until some condition, checked
+    // outside of any lock, may have changed. Waiters call prepare, re-check
+    // their condition, then wait (or cancel); notifiers make the condition
+    // true and then call notify, which only enters the kernel if somebody
+    // is actually asleep.
+    //
+    class event_count
+    {
+    public:
+        event_count (void) noexcept : seq (0), waiters (0) {}
+
+        event_count (event_count const&) = delete;
+        event_count & operator= (event_count const&) = delete;
+
+        std::uint32_t prepare (void) noexcept
+        {
+            waiters.fetch_add (1, std::memory_order_seq_cst);
+            return seq.load (std::memory_order_seq_cst);
+        }
+
+        void cancel (void) noexcept
+        {
+            waiters.fetch_sub (1, std::memory_order_relaxed);
+        }
+
+        void wait (std::uint32_t key) noexcept
+        {
+            futex_wait (&seq, key, false);
+            waiters.fetch_sub (1, std::memory_order_relaxed);
+        }
+
+        void notify (bool all = false) noexcept
+        {
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            if (waiters.load (std::memory_order_relaxed)) {
+                seq.fetch_add (1, std::memory_order_release);
+                futex_wake (&seq, all ? INT_MAX : 1, false);
+            }
+        }
+
+    private:
+        std::atomic<std::uint32_t> seq;
+        std::atomic<std::uint32_t> waiters;
+    };
+
+
+    // wait until ready() holds according to the given policy; ev is the
+    // event_count notified whenever ready() may have become true.
+    //
+    template <typename Ready>
+    void wait_until (Ready && ready, event_count & ev, wait_policy policy)
+    {
+        if (policy != wait_policy::block) {
+            for (int i = 0; i < 128; ++i) {
+                if (ready ())
+                    return;
+                cpu_relax ();
+            }
+
+            for (int i = 0; policy == wait_policy::spin || i < 4; ++i) {
+                ::sched_yield ();
+                if (ready ())
+                    return;
+            }
+        }
+
+        for (;;) {
+            auto const key = ev.prepare ();
+            if (ready ()) {
+                ev.cancel ();
+                return;
+            }
+            ev.wait (key);
+            if (ready ())
+                return;
+        }
+    }
+} // namespace detail
+} // namespace gcomb
+
+#endif // ifndef GCOMB_SYNC_HPP
@@ -0,0 +1,491 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// topk : the k greatest values of a stream, and its most frequent ones.
+//
+//      // the 100 best scores, best first
+//      std::vector<float> best = gcomb::top_k (scores, 100);
+//
+//      // the same from batches, filtered with SIMD compares
+//      auto best = gcomb::top_k (gcomb::chunk (scores, 4096), 100);
+//
+//      // items by a member
+//      auto best = gcomb::top_k (items, 100, [] (item const& a, item const& b)
+//                                            { return a.score < b.score; });
+//
+//      // the (about) 50 most frequent urls
+//      auto r = gcomb::broadcast (urls, gcomb::space_saving<std::string> (50));
+//      for (auto const& c : std::get<0> (r).counters ()) ...
+//
+// note:
+//      bounded_heap keeps the k greatest values under cmp in a binary
+//      heap whose root is the least of them, the current threshold; a
+//      value enters only if it beats the threshold, and then replaces
+//      the root with a single sift down. Once the heap is full almost
+//      every value of a long stream is rejected by that one compare. The
+//      batch update does the rejecting in bulk: for float, double, 32
+//      bit integers (and 64 bit ones with SSE4.2) under std::less, it
+//      compares 16 (8) values at a time against the threshold with SSE2
+//      and only looks at the values of a group in which something beat
+//      it.
+//
+//      space_saving (k) is the Space-Saving algorithm (Metwally, Agrawal
+//      and El Abbadi, "Efficient computation of frequent and top-k
+//      elements in data streams", 2005): k counters; a new value takes
+//      over the smallest counter, inheriting its count as error. Any
+//      value occurring more than n / k times is among the counters, and
+//      each count overestimates the true one by at most its error.
+//      Counters sit in a min-heap on count, located through an open
+//      addressing table, so an update is a lookup and a short sift.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_TOPK_HPP
+#define GCOMB_TOPK_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "algebraic_generator.hpp"
+#include "generator.hpp"
+#include "sketch.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+namespace detail
+{
+    // the index of the first of p[0, n) that beats t, or n
+    //
+    template <typename T, typename Compare>
+    std::size_t first_above (T const* p, std::size_t n, T const& t, Compare const& cmp)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            if (cmp (t, p[i]))
+                return i;
+        return n;
+    }
+
+#if defined(__SSE2__)
+    // scan groups of 4 vectors whose compare masks are or'ed together;
+    // Load (p) loads a vector, Gt (x) compares it against the threshold
+    // and Mask (x) gives a non zero movemask if any lane is set.
+    //
+    template <std::size_t Lanes, typename T, typename Load, typename Gt, typename Mask>
+    std::size_t first_above_simd (T const* p, std::size_t n, T const& t,
+                                  Load load, Gt gt, Mask mask)
+    {
+        constexpr std::size_t group = 4 * Lanes;
+
+        std::size_t i = 0;
+        for (; i + group <= n; i += group) {
+            auto const a = gt (load (p + i));
+            auto const b = gt (load (p + i + Lanes));
+            auto const c = gt (load (p + i + 2 * Lanes));
+            auto const d = gt (load (p + i + 3 * Lanes));
+            if (mask (a, b, c, d))
+                break;
+        }
+
+        return i + first_above (p + i, n - i, t, std::less<T> ());
+    }
+
+
+    inline std::size_t first_above (float const* p, std::size_t n, float const& t,
+                                    std::less<float> const&)
+    {
+        auto const th = _mm_set1_ps (t);
+        return first_above_simd<4> (p, n, t,
+            [] (float const* q) { return _mm_loadu_ps (q); },
+            [th] (__m128 x) { return _mm_cmpgt_ps (x, th); },
+            [] (__m128 a, __m128 b, __m128 c, __m128 d)
+            {
+                return _mm_movemask_ps (_mm_or_ps (_mm_or_ps (a, b), _mm_or_ps (c, d)));
+            });
+    }
+
+
+    inline std::size_t first_above (double const* p, std::size_t n, double const& t,
+                                    std::less<double> const&)
+    {
+        auto const th = _mm_set1_pd (t);
+        return first_above_simd<2> (p, n, t,
+            [] (double const* q) { return _mm_loadu_pd (q); },
+            [th] (__m128d x) { return _mm_cmpgt_pd (x, th); },
+            [] (__m128d a, __m128d b, __m128d c, __m128d d)
+            {
+                return _mm_movemask_pd (_mm_or_pd (_mm_or_pd (a, b), _mm_or_pd (c, d)));
+            });
+    }
+
+
+    inline std::size_t first_above (std::int32_t const* p, std::size_t n, std::int32_t const& t,
+                                     std::less<std::int32_t> const&)
+    {
+        auto const th = _mm_set1_epi32 (t);
+        return first_above_simd<4> (p, n, t,
+            [] (std::int32_t const* q) { return _mm_loadu_si128 (reinterpret_cast<__m128i const*> (q)); },
+            [th] (__m128i x) { return _mm_cmpgt_epi32 (x, th); },
+            [] (__m128i a, __m128i b, __m128i c, __m128i d)
+            {
+                return _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (a, b), _mm_or_si128 (c, d)));
+            });
+    }
+
+
+    inline std::size_t first_above (std::uint32_t const* p, std::size_t n, std::uint32_t const& t,
+                                     std::less<std::uint32_t> const&)
+    {
+        // unsigned order is signed order with the sign bit flipped
+        auto const bias = _mm_set1_epi32 (static_cast<int> (0x80000000u));
+        auto const th = _mm_xor_si128 (_mm_set1_epi32 (static_cast<int> (t)), bias);
+        return first_above_simd<4> (p, n, t,
+            [] (std::uint32_t const* q) { return _mm_loadu_si128 (reinterpret_cast<__m128i const*> (q)); },
+            [th,bias] (__m128i x) { return _mm_cmpgt_epi32 (_mm_xor_si128 (x, bias), th); },
+            [] (__m128i a, __m128i b, __m128i c, __m128i d)
+            {
+                return _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (a, b), _mm_or_si128 (c, d)));
+            });
+    }
+#endif
+
+#if defined(__SSE4_2__)
+    inline std::size_t first_above (std::int64_t const* p, std::size_t n, std::int64_t const& t,
+                                     std::less<std::int64_t> const&)
+    {
+        auto const th = _mm_set1_epi64x (t);
+        return first_above_simd<2> (p, n, t,
+            [] (std::int64_t const* q) { return _mm_loadu_si128 (reinterpret_cast<__m128i const*> (q)); },
+            [th] (__m128i x) { return _mm_cmpgt_epi64 (x, th); },
+            [] (__m128i a, __m128i b, __m128i c, __m128i d)
+            {
+                return _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (a, b), _mm_or_si128 (c, d)));
+            });
+    }
+#endif
+
+
+    // replace the root of a heap (ordered by before) and restore it
+    //
+    template <typename T, typename Before>
+    void heap_replace_top (std::vector<T> & heap, T value, Before const& before)
+    {
+        auto const n = heap.size ();
+        std::size_t i = 0;
+
+        for (;;) {
+            auto c = 2 * i + 1;
+            if (c >= n)
+                break;
+            if (c + 1 < n && before (heap[c + 1], heap[c]))
+                ++c;
+            if (not before (heap[c], value))
+                break;
+            heap[i] = std::move (heap[c]);
+            i = c;
+        }
+        heap[i] = std::move (value);
+    }
+} // namespace detail
+
+    // the k greatest values offered, under cmp
+    //
+    template <typename T, typename Compare = std::less<T>>
+    class bounded_heap
+    {
+    public:
+        explicit bounded_heap (std::size_t k, Compare cmp = Compare ())
+            : k (k), cmp (cmp)
+        {
+            heap.reserve (k);
+        }
+
+        void operator() (T const& value)
+        {
+            if (heap.size () < k)
+                push (value);
+            else if (k && cmp (heap.front (), value))
+                detail::heap_replace_top (heap, value, before ());
+        }
+
+        void batch (view<T> const& values)
+        {
+            auto p = values.begin ();
+            auto n = values.size ();
+
+            for (; n && heap.size () < k; --n)
+                push (*p++);
+
+            while (n && k) {
+                auto const i = detail::first_above (p, n, heap.front (), cmp);
+                if (i == n)
+                    break;
+                detail::heap_replace_top (heap, p[i], before ());
+                p += i + 1;
+                n -= i + 1;
+            }
+        }
+
+        void merge (bounded_heap const& other)
+        {
+            for (auto const& x : other.heap)
+                (*this) (x);
+        }
+
+        // the values kept, greatest first
+        //
+        std::vector<T> values (void) const
+        {
+            auto out = heap;
+            auto const c = cmp;
+            std::sort (out.begin (), out.end (), [c] (T const& a, T const& b) { return c (b, a); });
+            return out;
+        }
+
+    private:
+        // heap order: the least value at the root
+        //
+        struct least_first
+        {
+            Compare cmp;
+            bool operator() (T const& a, T const& b) const { return cmp (a, b); }
+        };
+
+        least_first before (void) const
+        {
+            return least_first {cmp};
+        }
+
+        void push (T const& value)
+        {
+            heap.push_back (value);
+            auto const b = before ();
+            std::push_heap (heap.begin (), heap.end (),
+                [&b] (T const& x, T const& y) { return b (y, x); });
+        }
+
+        std::size_t k;
+        std::vector<T> heap;
+        Compare cmp;
+    };
+
+
+    // the k greatest values of a bounded generator, greatest first
+    //
+    template <typename T, typename Compare = std::less<T>>
+    std::vector<T> top_k (algebraic_generator<T, bot_t> const& g, std::size_t k,
+                          Compare cmp = Compare ())
+    {
+        bounded_heap<T, Compare> h (k, cmp);
+        for (;;) {
+            auto const v = g ();
+            if (is_bot (v))
+                return h.values ();
+            h (v.template value<T> ());
+        }
+    }
+
+
+    // the k greatest values of a stream of batches, greatest first
+    //
+    template <typename T, typename Compare = std::less<T>>
+    std::vector<T> top_k (algebraic_generator<view<T>, bot_t> const& batches, std::size_t k,
+                          Compare cmp = Compare ())
+    {
+        bounded_heap<T, Compare> h (k, cmp);
+        for (;;) {
+            auto const v = batches ();
+            if (is_bot (v))
+                return h.values ();
+            h.batch (v.template value<view<T>> ());
+        }
+    }
+
+
+    template <typename T>
+    struct heavy_hitter
+    {
+        T value;
+        std::uint64_t count;    // at least the true count
+        std::uint64_t error;    // count - error is at most the true count
+    };
+
+
+    // frequent values in k counters (Space-Saving)
+    //
+    template <typename T, typename Hash = std::hash<T>>
+    class space_saving
+    {
+    public:
+        explicit space_saving (std::size_t k, Hash hash = Hash ())
+            : k (k ? k : 1), slots (16), n (0), hash (hash)
+        {
+            while (slots.size () < 2 * this->k)
+                slots.resize (2 * slots.size ());
+            counters_.reserve (this->k);
+            heap.reserve (this->k);
+        }
+
+        void operator() (T const& value, std::uint64_t weight = 1)
+        {
+            n += weight;
+            auto const h = detail::sketch_mix (hash (value));
+
+            auto const s = find (value, h);
+            if (slots[s]) {
+                auto const c = slots[s] - 1;
+                counters_[c].count += weight;
+                sift_down (pos[c]);
+                return;
+            }
+
+            if (counters_.size () < k) {
+                auto const c = static_cast<std::uint32_t> (counters_.size ());
+                counters_.push_back (counter {value, weight, 0, h});
+                pos.push_back (static_cast<std::uint32_t> (heap.size ()));
+                heap.push_back (c);
+                slots[s] = c + 1;
+                sift_up (pos[c]);
+                return;
+            }
+
+            // take over the smallest counter
+            auto const c = heap.front ();
+            auto & e = counters_[c];
+            erase (e.value, e.hash);
+
+            e.value = value;
+            e.hash  = h;
+            e.error = e.count;
+            e.count += weight;
+            slots[find (value, h)] = c + 1;
+            sift_down (0);
+        }
+
+        void batch (view<T> const& values)
+        {
+            for (auto const& x : values)
+                (*this) (x);
+        }
+
+        // the counters, most frequent first
+        //
+        std::vector<heavy_hitter<T>> counters (void) const
+        {
+            std::vector<heavy_hitter<T>> out;
+            out.reserve (counters_.size ());
+            for (auto const& c : counters_)
+                out.push_back (heavy_hitter<T> {c.value, c.count, c.error});
+
+            std::sort (out.begin (), out.end (),
+                [] (heavy_hitter<T> const& a, heavy_hitter<T> const& b)
+                {
+                    return a.count > b.count;
+                });
+            return out;
+        }
+
+        // values offered so far (total weight)
+        //
+        std::uint64_t seen (void) const noexcept
+        {
+            return n;
+        }
+
+    private:
+        struct counter
+        {
+            T value;
+            std::uint64_t count;
+            std::uint64_t error;
+            std::uint64_t hash;
+        };
+
+        // the slot holding value, or the free slot where it belongs
+        //
+        std::size_t find (T const& value, std::uint64_t h) const
+        {
+            auto const mask = slots.size () - 1;
+            auto i = static_cast<std::size_t> (h) & mask;
+            while (slots[i] && not (counters_[slots[i] - 1].value == value))
+                i = (i + 1) & mask;
+            return i;
+        }
+
+        // remove value from the table, shifting later entries back
+        //
+        void erase (T const& value, std::uint64_t h)
+        {
+            auto const mask = slots.size () - 1;
+            auto i = find (value, h);
+
+            for (auto j = (i + 1) & mask; slots[j]; j = (j + 1) & mask) {
+                auto const home = static_cast<std::size_t> (counters_[slots[j] - 1].hash) & mask;
+                // j's entry may move to i if i lies cyclically in [home, j)
+                if (((j - home) & mask) >= ((j - i) & mask)) {
+                    slots[i] = slots[j];
+                    i = j;
+                }
+            }
+            slots[i] = 0;
+        }
+
+        void swap_nodes (std::size_t a, std::size_t b) noexcept
+        {
+            std::swap (heap[a], heap[b]);
+            pos[heap[a]] = static_cast<std::uint32_t> (a);
+            pos[heap[b]] = static_cast<std::uint32_t> (b);
+        }
+
+        std::uint64_t count_at (std::size_t i) const noexcept
+        {
+            return counters_[heap[i]].count;
+        }
+
+        void sift_up (std::size_t i) noexcept
+        {
+            while (i && count_at (i) < count_at ((i - 1) / 2)) {
+                swap_nodes (i, (i - 1) / 2);
+                i = (i - 1) / 2;
+            }
+        }
+
+        void sift_down (std::size_t i) noexcept
+        {
+            for (;;) {
+                auto c = 2 * i + 1;
+                if (c >= heap.size ())
+                    return;
+                if (c + 1 < heap.size () && count_at (c + 1) < count_at (c))
+                    ++c;
+                if (count_at (i) <= count_at (c))
+                    return;
+                swap_nodes (i, c);
+                i = c;
+            }
+        }
+
+        std::size_t k;
+        std::vector<counter> counters_;
+        std::vector<std::uint32_t> heap;    // counter indices, min-heap on count
+        std::vector<std::uint32_t> pos;     // heap position of each counter
+        std::vector<std::uint32_t> slots;   // counter index + 1; 0 when free
+        std::uint64_t n;
+        Hash hash;
+    };
+} // namespace gcomb
+
+#endif // ifndef GCOMB_TOPK_HPP
@@ -0,0 +1,388 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// varint : sources decoding LEB128 varint streams, optionally
+//          zigzag and/or delta coded (e.g. sorted id lists).
+//
+//      varint_batches : views of up to `batch` decoded values
+//      varints        : the decoded values one at a time
+//
+// note:
+//      Values are produced as std::uint64_t; streams written with
+//      zigzag coding carry signed values and may be cast back to
+//      std::int64_t. With delta coding each decoded value is added to
+//      the previous output (the first to zero).
+//
+//      The bulk decoder inspects 16 input bytes at a time (SSE2 when
+//      available): a window of sixteen one-byte varints, common for
+//      delta coded sorted ids, is widened in a handful of instructions,
+//      and otherwise the continuation bit mask locates every varint
+//      ending in the window without testing bytes one by one.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_VARINT_HPP
+#define GCOMB_VARINT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "algebraic_generator.hpp"
+#include "combinators.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "view.hpp"
+
+namespace gcomb
+{
+    enum class varint_coding
+    {
+        plain,
+        zigzag,
+        delta,
+        zigzag_delta
+    };
+
+
+    inline std::uint64_t zigzag_encode (std::int64_t v) noexcept
+    {
+        return (static_cast<std::uint64_t> (v) << 1) ^
+            static_cast<std::uint64_t> (v >> 63);
+    }
+
+
+    inline std::int64_t zigzag_decode (std::uint64_t v) noexcept
+    {
+        return static_cast<std::int64_t> ((v >> 1) ^ (~(v & 1) + 1));
+    }
+
+
+    // append the LEB128 encoding of v to out
+    //
+    template <typename Bytes>
+    void put_varint (Bytes & out, std::uint64_t v)
+    {
+        while (v >= 0x80) {
+            out.push_back (static_cast<typename Bytes::value_type> (v | 0x80));
+            v >>= 7;
+        }
+        out.push_back (static_cast<typename Bytes::value_type> (v));
+    }
+
+namespace detail
+{
+    [[noreturn]] inline void throw_bad_varint (void)
+    {
+        throw std::runtime_error ("gcomb: malformed varint (over 10 bytes)");
+    }
+
+
+    // assemble the varint occupying [p, p + len)
+    //
+    inline std::uint64_t assemble_varint (std::uint8_t const* p,
+                                          unsigned len) noexcept
+    {
+        std::uint64_t v = 0;
+        for (unsigned i = 0; i < len; ++i)
+            v |= static_cast<std::uint64_t> (p[i] & 0x7f) << (7 * i);
+        return v;
+    }
+
+
+    // decode complete varints from [p, end) into out (at most max of
+    // them), advancing p past what was consumed. An incomplete varint
+    // at the end of the input is left unconsumed.
+    //
+    inline std::size_t decode_varints (std::uint8_t const*& p,
+                                       std::uint8_t const* end,
+                                       std::uint64_t * out,
+                                       std::size_t max)
+    {
+        std::size_t n = 0;
+
+    #if defined(__SSE2__)
+        while (n + 16 <= max && end - p >= 16) {
+            auto const bytes = _mm_loadu_si128
+                (reinterpret_cast<__m128i const*> (p));
+            auto const cont = static_cast<unsigned>
+                (_mm_movemask_epi8 (bytes));
+
+            if (cont == 0) {
+                // sixteen single byte varints: zero extend to 64 bits
+                auto const zero = _mm_setzero_si128 ();
+                auto const w16lo = _mm_unpacklo_epi8 (bytes, zero);
+                auto const w16hi = _mm_unpackhi_epi8 (bytes, zero);
+
+                __m128i const w32[4] = {
+                    _mm_unpacklo_epi16 (w16lo, zero),
+                    _mm_unpackhi_epi16 (w16lo, zero),
+                    _mm_unpacklo_epi16 (w16hi, zero),
+                    _mm_unpackhi_epi16 (w16hi, zero)
+                };
+
+                auto dst = reinterpret_cast<__m128i *> (out + n);
+                for (int i = 0; i < 4; ++i) {
+                    _mm_storeu_si128 (dst + 2 * i,
+                                      _mm_unpacklo_epi32 (w32[i], zero));
+                    _mm_storeu_si128 (dst + 2 * i + 1,
+                                      _mm_unpackhi_epi32 (w32[i], zero));
+                }
+
+                p += 16;
+                n += 16;
+                continue;
+            }
+
+            // every clear bit of the mask terminates a varint
+            auto ends = ~cont & 0xffffu;
+            if (ends == 0)
+                break; // sixteen continuation bytes; let the scalar loop fail
+
+            unsigned pos = 0;
+            while (ends) {
+                auto const last = static_cast<unsigned> (__builtin_ctz (ends));
+                if (last - pos >= 10)
+                    throw_bad_varint ();
+                out[n++] = assemble_varint (p + pos, last - pos + 1);
+                pos = last + 1;
+                ends &= ends - 1;
+            }
+            p += pos;
+        }
+    #endif
+
+        while (n < max && p < end) {
+            auto q = p;
+            unsigned len = 0;
+            while (q < end && (*q & 0x80)) {
+                ++q;
+                if (++len >= 10)
+                    throw_bad_varint ();
+            }
+            if (q == end)
+                break; // incomplete; wait for more input
+
+            out[n++] = assemble_varint (p, len + 1);
+            p = q + 1;
+        }
+
+        return n;
+    }
+
+
+    // undo zigzag/delta coding in place; prev carries the running
+    // total across batches.
+    //
+    inline void apply_coding (std::uint64_t * v, std::size_t n,
+                              varint_coding coding,
+                              std::uint64_t & prev) noexcept
+    {
+        switch (coding) {
+            case varint_coding::plain:
+                break;
+            case varint_coding::zigzag:
+                for (std::size_t i = 0; i < n; ++i)
+                    v[i] = static_cast<std::uint64_t> (zigzag_decode (v[i]));
+                break;
+            case varint_coding::delta:
+                for (std::size_t i = 0; i < n; ++i)
+                    v[i] = prev += v[i];
+                break;
+            case varint_coding::zigzag_delta:
+                for (std::size_t i = 0; i < n; ++i)
+                    v[i] = prev +=
+                        static_cast<std::uint64_t> (zigzag_decode (v[i]));
+                break;
+        }
+    }
+
+
+    struct varint_decoder
+    {
+        std::vector<std::uint64_t> out;
+        varint_coding coding;
+        std::uint64_t prev;
+
+        varint_decoder (std::size_t batch, varint_coding c)
+            : out (batch ? batch : 1), coding (c), prev (0)
+        {}
+
+        // decode as much of [p, end) as fits in one batch
+        //
+        view<std::uint64_t> decode (std::uint8_t const*& p,
+                                    std::uint8_t const* end)
+        {
+            auto const n = decode_varints (p, end, out.data (), out.size ());
+            apply_coding (out.data (), n, coding, prev);
+            return make_view (static_cast<std::uint64_t const*> (out.data ()), n);
+        }
+    };
+} // namespace detail
+
+    using varint_batch_generator =
+        algebraic_generator<view<std::uint64_t>, bot_t>;
+
+
+    // decode the varints held in [data, data + size); the buffer must
+    // outlive the generator. A trailing incomplete varint is an error.
+    //
+    inline varint_batch_generator
+        varint_batches (std::uint8_t const* data, std::size_t size,
+                        varint_coding coding = varint_coding::plain,
+                        std::size_t batch = 1024)
+    {
+        using A = algebraic::algebraic<view<std::uint64_t>, bot_t>;
+
+        struct state
+        {
+            detail::varint_decoder dec;
+            std::uint8_t const* p;
+            std::uint8_t const* end;
+        };
+
+        auto const st = std::make_shared<state>
+            (state {detail::varint_decoder (batch, coding), data, data + size});
+
+        return varint_batch_generator
+            ([st] (void) -> A
+            {
+                if (st->p == st->end)
+                    return A (bot_t{});
+
+                auto const v = st->dec.decode (st->p, st->end);
+                if (v.empty ())
+                    throw std::runtime_error
+                        ("gcomb: truncated varint at end of input");
+
+                return A (v);
+            });
+    }
+
+
+    // decode the varints in a file (mapped, not read)
+    //
+    inline varint_batch_generator
+        varint_batches (std::string const& path,
+                        varint_coding coding = varint_coding::plain,
+                        std::size_t batch = 1024)
+    {
+        auto const file = std::make_shared<mapped_file> (path);
+        file->advise (0, file->size (), MADV_SEQUENTIAL);
+
+        auto const inner = varint_batches
+            (reinterpret_cast<std::uint8_t const*> (file->data ()),
+             file->size (), coding, batch);
+
+        using A = algebraic::algebraic<view<std::uint64_t>, bot_t>;
+
+        // the closure keeps the mapping alive as long as the generator
+        return varint_batch_generator
+            ([file,inner] (void) -> A { return inner (); });
+    }
+
+
+    // decode varints from a block stream (e.g. the output of inflate);
+    // varints may straddle block boundaries.
+    //
+    inline varint_batch_generator
+        varint_batches (block_generator const& blocks,
+                        varint_coding coding = varint_coding::plain,
+                        std::size_t batch = 1024)
+    {
+        using A = algebraic::algebraic<view<std::uint64_t>, bot_t>;
+
+        struct state
+        {
+            block_generator blocks;
+            detail::varint_decoder dec;
+            std::uint8_t const* p;
+            std::uint8_t const* end;
+            std::vector<std::uint8_t> carry;
+        };
+
+        auto const st = std::make_shared<state>
+            (state {blocks, detail::varint_decoder (batch, coding),
+                    nullptr, nullptr, {}});
+
+        return varint_batch_generator
+            ([st] (void) -> A
+            {
+                for (;;) {
+                    if (st->p != st->end) {
+                        auto const v = st->dec.decode (st->p, st->end);
+                        if (not v.empty ())
+                            return A (v);
+
+                        // keep the incomplete tail, at most ten bytes
+                        st->carry.assign (st->p, st->end);
+                        st->p = st->end = nullptr;
+                    }
+
+                    auto const next = st->blocks ();
+                    if (is_bot (next)) {
+                        if (not st->carry.empty ())
+                            throw std::runtime_error
+                                ("gcomb: truncated varint at end of input");
+                        return A (bot_t{});
+                    }
+
+                    auto const blk = next.template value<view<char>> ();
+                    auto b = reinterpret_cast<std::uint8_t const*> (blk.first);
+                    auto const bend = b + blk.count;
+
+                    if (not st->carry.empty ()) {
+                        // finish the straddling varint before bulk decoding
+                        while (b < bend) {
+                            st->carry.push_back (*b);
+                            if (not (*b++ & 0x80))
+                                break;
+                            if (st->carry.size () >= 10)
+                                detail::throw_bad_varint ();
+                        }
+
+                        if (st->carry.back () & 0x80)
+                            continue;
+
+                        std::uint8_t const* cp = st->carry.data ();
+                        auto const v = st->dec.decode
+                            (cp, cp + st->carry.size ());
+                        st->carry.clear ();
+                        st->p = b;
+                        st->end = bend;
+                        return A (v);
+                    }
+
+                    st->p = b;
+                    st->end = bend;
+                }
+            });
+    }
+
+
+    template <typename Source>
+    algebraic_generator<std::uint64_t, bot_t>
+        varints (Source && src, varint_coding coding = varint_coding::plain)
+    {
+        return flatten (varint_batches (std::forward<Source> (src), coding));
+    }
+
+
+    inline algebraic_generator<std::uint64_t, bot_t>
+        varints (std::uint8_t const* data, std::size_t size,
+                 varint_coding coding = varint_coding::plain)
+    {
+        return flatten (varint_batches (data, size, coding));
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_VARINT_HPP
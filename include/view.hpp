@@ -0,0 +1,74 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// view : a non-owning, trivially copyable window onto
+//        contiguous storage held by a generator.
+//
+// note:
+//      Generators that reuse an internal buffer across calls
+//      (blocks, lines, windows, ...) hand out views rather than
+//      copies. A view is only valid until the next call to the
+//      generator that produced it; copy the elements out if they
+//      must outlive that.
+//
+//      Because a view is trivially copyable it may be carried
+//      inside an algebraic<view<T>, bot_t> by bounded generators.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#ifndef GCOMB_VIEW_HPP
+#define GCOMB_VIEW_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace gcomb
+{
+    template <typename T>
+    struct view
+    {
+        using value_type      = T;
+        using const_reference = T const&;
+        using const_iterator  = T const*;
+
+        T const*    first;
+        std::size_t count;
+
+        T const* begin (void) const noexcept { return first; }
+        T const* end   (void) const noexcept { return first + count; }
+
+        T const* data (void) const noexcept { return first; }
+
+        std::size_t size (void) const noexcept { return count; }
+        bool empty (void) const noexcept { return count == 0; }
+
+        T const& operator[] (std::size_t i) const noexcept
+        {
+            return first[i];
+        }
+
+        T const& front (void) const noexcept { return first[0]; }
+        T const& back  (void) const noexcept { return first[count - 1]; }
+    };
+
+
+    template <typename T>
+    view<T> make_view (T const* first, std::size_t count) noexcept
+    {
+        return view<T> {first, count};
+    }
+
+
+    // copy the characters of a byte view out into a string,
+    // e.g. when a line must outlive the next call.
+    //
+    inline std::string to_string (view<char> const& v)
+    {
+        return std::string (v.first, v.count);
+    }
+} // namespace gcomb
+
+#endif // ifndef GCOMB_VIEW_HPP
@@ -0,0 +1,57 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// bloom_filter_fp : the false positive rate of bloom_filter (distinct.hpp)
+//                   stays within its target at sizes past 2^16 blocks.
+//
+//      (from the repository root)
+//      g++ -std=c++14 -O2 -Iinclude -Iinclude/algebraic/include
+//          tests/bloom_filter_fp.cpp -o bloom_filter_fp
+//      ./bloom_filter_fp
+//
+// note:
+//      At these sizes the block index takes more than 16 bits of the
+//      hash; bits of a value's block that are not drawn independently
+//      of its index push the rate well past the target (to about 1.4%
+//      at a 1% target for 3e7 values). Exits non-zero on failure.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#include <cstdint>
+#include <cstdio>
+
+#include "distinct.hpp"
+
+namespace
+{
+    bool check (std::size_t n, double target)
+    {
+        gcomb::bloom_filter<std::uint64_t> f (n, target);
+        for (std::uint64_t i = 0; i < n; ++i)
+            f.insert (i);
+
+        std::size_t const probes = 4000000;
+        std::size_t fp = 0;
+        for (std::uint64_t i = 0; i < probes; ++i)
+            fp += f.contains (n + i);
+
+        auto const blocks = f.size () / 64;
+        auto const rate = static_cast<double> (fp) / probes;
+        bool const ok = blocks > (std::size_t (1) << 16) && rate <= target;
+
+        std::printf ("%s: n = %zu, blocks = %zu, target = %g, measured = %g\n",
+                     ok ? "ok" : "FAIL", n, blocks, target, rate);
+        return ok;
+    }
+} // namespace
+
+int main (void)
+{
+    bool ok = true;
+    ok = check (30000000, 0.01) && ok;
+    ok = check (10000000, 0.001) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// prefix_sum : the SSE2 running sums (fold.hpp) agree with the scalar
+//              loop for every element type they cover.
+//
+//      (from the repository root)
+//      g++ -std=c++14 -O2 -Iinclude -Iinclude/algebraic/include
+//          tests/prefix_sum.cpp -o prefix_sum
+//      ./prefix_sum
+//
+// note:
+//      Lengths 0 to 67 cover whole vectors, the scalar tail and the
+//      carry handed between them. Unsigned inputs wrap; signed and
+//      floating point inputs are small integers, whose sums are exact,
+//      so the vector kernels' different order of addition must
+//      give the scalar result bit for bit. The generator is checked
+//      against the scalar sum across batches too. Exits non-zero on
+//      failure.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "fold.hpp"
+
+namespace
+{
+    // unsigned values wrap; signed ones must not overflow
+    //
+    template <typename T>
+    typename std::enable_if<std::is_unsigned<T>::value, T>::type
+        draw (std::mt19937_64 & rng)
+    {
+        return static_cast<T> (rng ());
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_signed<T>::value, T>::type
+        draw (std::mt19937_64 & rng)
+    {
+        return static_cast<T> (static_cast<int> (rng () % 2001) - 1000);
+    }
+
+
+    template <typename T>
+    bool same (T const* a, T const* b, std::size_t n)
+    {
+        return std::memcmp (a, b, n * sizeof (T)) == 0;
+    }
+
+
+    template <typename T>
+    bool check (std::mt19937_64 & rng, char const* what)
+    {
+        for (std::size_t n = 0; n < 68; ++n) {
+            std::vector<T> in (n), simd (n + 1), scalar (n + 1);
+            for (auto & x : in)
+                x = draw<T> (rng);
+            auto const carry = draw<T> (rng);
+
+            auto const a = gcomb::detail::prefix_sum (in.data (), simd.data (), n, carry);
+            auto const b = gcomb::detail::prefix_sum_scalar (in.data (), scalar.data (), n, carry);
+
+            if (not same (&a, &b, 1) || not same (simd.data (), scalar.data (), n + 1)) {
+                std::printf ("FAIL: %s: length %zu\n", what, n);
+                return false;
+            }
+        }
+
+        // the generator, over batches of uneven length
+        std::vector<T> all (1000);
+        for (auto & x : all)
+            x = draw<T> (rng);
+
+        std::vector<T> want (all.size ());
+        gcomb::detail::prefix_sum_scalar (all.data (), want.data (), all.size (), T (7));
+
+        std::size_t const cuts[] = {0, 3, 3, 40, 41, 333, 1000};
+
+        using A = algebraic::algebraic<gcomb::view<T>, gcomb::bot_t>;
+        auto const batches = gcomb::algebraic_generator<gcomb::view<T>, gcomb::bot_t>
+            ([&all,&cuts,i = std::size_t (0)] (void) mutable -> A
+            {
+                if (i + 1 == sizeof cuts / sizeof cuts[0])
+                    return A (gcomb::bot_t{});
+                auto const from = cuts[i], to = cuts[++i];
+                return A (gcomb::make_view (static_cast<T const*> (all.data () + from), to - from));
+            });
+
+        auto const sums = gcomb::prefix_sum (batches, T (7));
+        for (std::size_t k = 0;; ++k) {
+            auto const v = sums ();
+            if (gcomb::is_bot (v)) {
+                if (k + 1 == sizeof cuts / sizeof cuts[0])
+                    break;
+                std::printf ("FAIL: %s: generator ended after %zu batches\n", what, k);
+                return false;
+            }
+            auto const got = v.template value<gcomb::view<T>> ();
+            if (not same (got.data (), want.data () + cuts[k], got.size ()) ||
+                cuts[k] + got.size () != cuts[k + 1]) {
+                std::printf ("FAIL: %s: generator batch %zu\n", what, k);
+                return false;
+            }
+        }
+
+        std::printf ("ok: %s\n", what);
+        return true;
+    }
+} // namespace
+
+int main (void)
+{
+    std::mt19937_64 rng (64);
+    bool ok = true;
+
+    ok = check<std::uint32_t> (rng, "uint32") && ok;
+    ok = check<std::int32_t>  (rng, "int32")  && ok;
+    ok = check<std::uint64_t> (rng, "uint64") && ok;
+    ok = check<std::int64_t>  (rng, "int64")  && ok;
+    ok = check<float>         (rng, "float")  && ok;
+    ok = check<double>        (rng, "double") && ok;
+
+    return ok ? 0 : 1;
+}
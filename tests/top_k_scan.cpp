@@ -0,0 +1,142 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// top_k_scan : the SIMD threshold scans of top_k (topk.hpp) find the
+//              same value as the scalar loop.
+//
+//      (from the repository root)
+//      g++ -std=c++14 -O2 -msse4.2 -Iinclude -Iinclude/algebraic/include
+//          tests/top_k_scan.cpp -o top_k_scan
+//      ./top_k_scan
+//
+// note:
+//      detail::first_above under std::less picks the SSE2 (for int64,
+//      SSE4.2) overload; under any other comparator, the scalar
+//      template. Both are run over every length up to 80 (whole groups,
+//      partial groups and the tail) against thresholds at and near the
+//      top of the values, so the first value above lies anywhere or
+//      nowhere. Values cover the whole range of the integer types (the
+//      unsigned scan flips the sign bit), and floating point ones
+//      include NaN and signed zeros. bounded_heap::batch is also checked
+//      against offering the same values one at a time. Exits non-zero
+//      on failure.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "topk.hpp"
+
+namespace
+{
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, T>::type
+        draw (std::mt19937_64 & rng)
+    {
+        return static_cast<T> (rng ());
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value, T>::type
+        draw (std::mt19937_64 & rng)
+    {
+        return static_cast<T> (static_cast<std::int64_t> (rng ()) / 1e6);
+    }
+
+
+    // sprinkle in values compares get wrong most easily
+    //
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type
+        awkward (std::vector<T> &, std::mt19937_64 &)
+    {}
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+        awkward (std::vector<T> & vs, std::mt19937_64 & rng)
+    {
+        T const odd[] = {std::numeric_limits<T>::quiet_NaN (), T (0), -T (0)};
+        for (std::size_t i = 0; i < vs.size () / 8; ++i)
+            vs[rng () % vs.size ()] = odd[rng () % 3];
+    }
+
+
+    template <typename T>
+    bool check (std::mt19937_64 & rng, char const* what)
+    {
+        auto const scalar_less = [] (T const& a, T const& b) { return a < b; };
+
+        for (std::size_t n = 0; n <= 80; ++n)
+            for (int trial = 0; trial < 50; ++trial) {
+                std::vector<T> vs (n);
+                for (auto & x : vs)
+                    x = draw<T> (rng);
+
+                // a threshold among the greatest few values, the least
+                // possible one or an arbitrary one
+                auto sorted = vs;
+                std::sort (sorted.begin (), sorted.end ());
+                auto const r = static_cast<std::size_t> (trial % 6);
+                auto const t = r < 4 && r < n ? sorted[n - 1 - r] :
+                               r == 4 ? std::numeric_limits<T>::lowest () : draw<T> (rng);
+
+                awkward (vs, rng);
+
+                auto const simd   = gcomb::detail::first_above (vs.data (), n, t, std::less<T> ());
+                auto const scalar = gcomb::detail::first_above (vs.data (), n, t, scalar_less);
+
+                if (simd != scalar) {
+                    std::printf ("FAIL: %s: length %zu: %zu, not %zu\n", what, n, simd, scalar);
+                    return false;
+                }
+            }
+
+        // batches through the heap keep what single values would
+        std::vector<T> vs (100000);
+        for (auto & x : vs)
+            x = draw<T> (rng);
+
+        gcomb::bounded_heap<T> one (100), many (100);
+        for (auto const& x : vs)
+            one (x);
+        for (std::size_t i = 0; i < vs.size (); i += 4093)
+            many.batch (gcomb::make_view (static_cast<T const*> (vs.data () + i),
+                                          std::min<std::size_t> (4093, vs.size () - i)));
+
+        if (one.values () != many.values ()) {
+            std::printf ("FAIL: %s: bounded_heap::batch\n", what);
+            return false;
+        }
+
+        std::printf ("ok: %s\n", what);
+        return true;
+    }
+} // namespace
+
+int main (void)
+{
+    std::mt19937_64 rng (74);
+    bool ok = true;
+
+    ok = check<float>         (rng, "float")  && ok;
+    ok = check<double>        (rng, "double") && ok;
+    ok = check<std::int32_t>  (rng, "int32")  && ok;
+    ok = check<std::uint32_t> (rng, "uint32") && ok;
+    ok = check<std::int64_t>  (rng, "int64")  && ok;
+
+#if not defined(__SSE4_2__)
+    std::printf ("note: built without SSE4.2; the int64 scan is scalar\n");
+#endif
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// gcomb : composable generator combinators for elegant
+//         manipulation of infinite data streams.
+//
+// varint_decode : the bulk varint decoder (varint.hpp) returns what
+//                 put_varint encoded, on its SSE2 path and off it.
+//
+//      (from the repository root)
+//      g++ -std=c++14 -O2 -Iinclude -Iinclude/algebraic/include
+//          tests/varint_decode.cpp -o varint_decode
+//      ./varint_decode
+//
+// note:
+//      Each mix of lengths is decoded with several batch sizes and with
+//      the input cut short at every byte of its first 256, so windows of
+//      sixteen one byte varints, windows ending mid varint and the
+//      scalar tail are all exercised. Building with -mno-sse2
+//      (on a target that allows it) runs the same checks against the
+//      scalar loop alone. Exits non-zero on failure.
+//
+// Author: Dalton Woodard
+// Contact: daltonmwoodard@gmail.com
+// License: Please see LICENSE
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "varint.hpp"
+
+namespace
+{
+    // values whose encodings are 1 to 10 bytes long, mostly one byte
+    // long when runs is set
+    //
+    std::vector<std::uint64_t> make_values (std::mt19937_64 & rng,
+                                            std::size_t n, bool runs)
+    {
+        std::vector<std::uint64_t> vs (n);
+        for (auto & v : vs) {
+            auto const bits = runs && rng () % 8 ? 7 : 1 + rng () % 64;
+            v = bits == 64 ? rng () : rng () & ((std::uint64_t (1) << bits) - 1);
+        }
+        return vs;
+    }
+
+
+    bool check (std::vector<std::uint64_t> const& vs, char const* what)
+    {
+        // the encoding, and where each value's encoding ends in it
+        std::vector<std::uint8_t> bytes;
+        std::vector<std::size_t> ends;
+        for (auto v : vs) {
+            gcomb::put_varint (bytes, v);
+            ends.push_back (bytes.size ());
+        }
+
+        auto const end = bytes.data () + bytes.size ();
+        std::vector<std::uint64_t> out (vs.size ());
+
+        // the whole input, max values at a time
+        for (std::size_t max : {vs.size (), std::size_t (1), std::size_t (15),
+                                std::size_t (16), std::size_t (17), std::size_t (64)}) {
+            std::vector<std::uint64_t> got;
+            auto p = static_cast<std::uint8_t const*> (bytes.data ());
+            while (p != end) {
+                auto const n = gcomb::detail::decode_varints (p, end, out.data (), max);
+                if (n == 0 || n > max) {
+                    std::printf ("FAIL: %s: no progress at max %zu\n", what, max);
+                    return false;
+                }
+                got.insert (got.end (), out.begin (), out.begin () + n);
+            }
+
+            if (got != vs) {
+                std::printf ("FAIL: %s: values differ at max %zu\n", what, max);
+                return false;
+            }
+        }
+
+        // input cut short: every complete varint, and no more
+        for (std::size_t cut = 0; cut < bytes.size () && cut < 256; ++cut) {
+            auto p = static_cast<std::uint8_t const*> (bytes.data ());
+            auto const n = gcomb::detail::decode_varints
+                (p, bytes.data () + cut, out.data (), out.size ());
+
+            std::size_t want = 0;
+            while (want < ends.size () && ends[want] <= cut)
+                ++want;
+
+            auto const used = static_cast<std::size_t> (p - bytes.data ());
+            if (n != want || used != (n ? ends[n - 1] : 0) ||
+                not std::equal (out.begin (), out.begin () + n, vs.begin ())) {
+                std::printf ("FAIL: %s: input cut at %zu\n", what, cut);
+                return false;
+            }
+        }
+
+        std::printf ("ok: %s (%zu values, %zu bytes)\n", what, vs.size (), bytes.size ());
+        return true;
+    }
+
+
+    bool check_malformed (void)
+    {
+        // eleven continuation bytes, preceded by enough one byte varints
+        // to reach the sixteen byte windows
+        for (std::size_t lead = 0; lead < 40; ++lead) {
+            std::vector<std::uint8_t> bytes (lead, 0x01);
+            bytes.insert (bytes.end (), 11, 0x80);
+            bytes.push_back (0x01);
+            bytes.insert (bytes.end (), 16, 0x01);
+
+            std::vector<std::uint64_t> out (bytes.size ());
+            auto p = static_cast<std::uint8_t const*> (bytes.data ());
+            try {
+                gcomb::detail::decode_varints (p, bytes.data () + bytes.size (),
+                                               out.data (), out.size ());
+                std::printf ("FAIL: malformed varint after %zu bytes accepted\n", lead);
+                return false;
+            } catch (std::runtime_error const&) {}
+        }
+
+        std::printf ("ok: malformed varints rejected\n");
+        return true;
+    }
+} // namespace
+
+int main (void)
+{
+    std::mt19937_64 rng (52);
+    bool ok = true;
+
+    ok = check (std::vector<std::uint64_t> (100, 5), "one byte runs") && ok;
+    ok = check (make_values (rng, 5000, true), "mostly one byte") && ok;
+    ok = check (make_values (rng, 5000, false), "mixed lengths") && ok;
+    ok = check (std::vector<std::uint64_t> (50, ~std::uint64_t (0)), "ten byte") && ok;
+    ok = check_malformed () && ok;
+
+    return ok ? 0 : 1;
+}